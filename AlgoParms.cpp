@@ -35,6 +35,9 @@ public:
 	virtual inline void Append(stringstream&) = 0;
 	virtual inline void Calculate(int n) {}
 	virtual inline void Set(string property, Ratio& r) { assert(false); }
+protected:
+	// Separate copy of an owned ratio, for the Clone of a derived class.
+	static inline Ratio* Copy(const Ratio* r) { return r == NULL ? NULL : new Ratio(*r); }
 };
 
 class RandomWalkParms : public AlgoParms
@@ -232,6 +235,22 @@ public:
 		if (IsThreaded()) s << " threads=" << Threads;
 	}
 
+	// Independent copy for a concurrent replicate of the same configuration.
+	inline GLSParms* Clone()
+	{
+		GLSParms *p = new GLSParms();
+		*p = *this; // values; the owned ratios are copied below
+		p->AspireLate = Copy(AspireLate);
+		p->BestMoveInterval = Copy(BestMoveInterval);
+		p->SteepestDescentInterval = Copy(SteepestDescentInterval);
+		p->EvaporateInterval = Copy(EvaporateInterval);
+		p->EvaporateSinceImproveInterval = Copy(EvaporateSinceImproveInterval);
+		p->AspireGood = Copy(AspireGood);
+		p->Steep.PerturbMin = Copy(Steep.PerturbMin); p->Steep.PerturbMax = Copy(Steep.PerturbMax);
+		p->Steep.TabuLength = Copy(Steep.TabuLength); p->Steep.TabuSearchSwaps = Copy(Steep.TabuSearchSwaps);
+		return p;
+	}
+
 	~GLSParms() 
 	{
 		delete AspireLate;
@@ -268,6 +287,14 @@ public:
 		u = U->Calculate(n);
 	}
 
+	inline TabuSearchParms* Clone()
+	{
+		TabuSearchParms *p = new TabuSearchParms();
+		*p = *this;
+		p->T = Copy(T); p->U = Copy(U);
+		return p;
+	}
+
 	~TabuSearchParms() 
 	{
 		delete T; delete U; 
@@ -381,7 +408,7 @@ public:
 			s << " exploit=" << Exploit->ToString() << " explore=" << Explore->ToString() << " defer=" << Defer->ToString();
 	}
 
-	MyTabuSearchParms() : T(NULL), U(NULL), UAuto(NULL), Jolt(NULL), JoltRate(NULL), JoltBest(false), UMax(NULL), DeltaUPercent(0), IncreaseRate(NULL), Constructor(NULL), ConstructRate(NULL), CoreSize(NULL), MaxCoreSize(NULL), TMax(NULL), Exploit(NULL), ScopeMin(-1), TIncreasePercentMax(0)
+	MyTabuSearchParms() : T(NULL), U(NULL), UAuto(NULL), Jolt(NULL), JoltRate(NULL), JoltBest(false), UMax(NULL), DeltaUPercent(0), IncreaseRate(NULL), Constructor(NULL), ConstructRate(NULL), CoreSize(NULL), CoreWorkPhaseLength(NULL), CorePhaseLength(NULL), MaxCoreSize(NULL), TMax(NULL), TIncreaseRate(NULL), Exploit(NULL), Explore(NULL), Defer(NULL), ScopeMin(-1), TIncreasePercentMax(0)
 	{
 		CoreConstructor = new CoreConstruct();
 	}
@@ -464,6 +491,26 @@ public:
 
 	}
 
+	// Independent copy for a concurrent replicate, or NULL when a jolt search, constructor or u equation is set:
+	// those are shared objects with no copy of their own.
+	inline MyTabuSearchParms* Clone()
+	{
+		if (UAuto != NULL || Jolt != NULL || Constructor != NULL)
+			return NULL;
+		MyTabuSearchParms *p = new MyTabuSearchParms();
+		CoreConstruct *core = p->CoreConstructor; // a fresh one of its own, kept over the assignment
+		*p = *this; // values; the owned ratios and the core constructor are replaced below
+		p->T = Copy(T); p->U = Copy(U);
+		p->UMax = Copy(UMax); p->IncreaseRate = Copy(IncreaseRate);
+		p->JoltRate = Copy(JoltRate); p->ConstructRate = Copy(ConstructRate);
+		p->CoreSize = Copy(CoreSize); p->CoreWorkPhaseLength = Copy(CoreWorkPhaseLength); p->CorePhaseLength = Copy(CorePhaseLength);
+		p->MaxCoreSize = Copy(MaxCoreSize);
+		p->TMax = Copy(TMax); p->TIncreaseRate = Copy(TIncreaseRate);
+		p->Exploit = Copy(Exploit); p->Explore = Copy(Explore); p->Defer = Copy(Defer);
+		p->CoreConstructor = core;
+		return p;
+	}
+
 	~MyTabuSearchParms() 
 	{
 		delete T; delete U; 
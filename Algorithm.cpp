@@ -2,6 +2,10 @@
 #include <vector>
 #include "Instance.cpp"
 #include "Solution.cpp"
+#include "BestTracker.cpp"
+#include "TabuMemory.cpp"
+#include "FeatureCosts.cpp"
+#include "Crew.cpp"
 #include <float.h>
 #include <fstream>
 #include <iomanip>
@@ -12,6 +16,7 @@
 #include <fstream>
 #include <sstream>
 #include <queue>
+#include <atomic>
 
 
 
@@ -27,7 +32,7 @@ public:
 	{
 		
 	} 
-	~Algorithm() 
+	virtual ~Algorithm() 
 	{ 
 		if (Output!=NULL) Output->close(); 
 		delete Output; 
@@ -37,34 +42,94 @@ public:
 	{
 		Problem = &runner.Problem;
 		Result* result = new Result(*Problem, GetParms()->Key);
-		double fitness;
+		if (GetParms()->Debug && !Solution::VerifyKernels(*Problem))
+			exit(1);
 
+		int threads = min(runner.Threads, runner.Runs);
+		if (threads > 1 && !GetParms()->Debug && RunConcurrently(runner, *result, threads))
+			return result;
 		for (int i=0; i<runner.Runs; ++i)
 		{
-			runner.Run();
-			
-			if (GetParms()->Debug)
-			{
-				stringstream ss;
-				ss << endl << Problem->ToString() << " run=" << i << endl ;
-				Debug(ss.str());
-			}
-
-			PreRun(runner);
-			while (!runner.IsDone()) 
-			{
-				fitness = Iterate(runner);
-				runner.Update(fitness);
-				Print(runner);
-				runner.Iterate();
-			}
-			PostRun();
-			Print(runner);
+			Replicate(runner, i);
 			result->Add(runner);
 		}
 		return result;
 	}
 
+	// Replicate i of the search on runner, which holds its outcome afterwards.  It draws from a stream of its own,
+	// derived from the runner's seed, so it comes out the same whether it runs alone or alongside others.
+	inline void Replicate(Runner& runner, int i)
+	{
+		double fitness;
+		RandomGenerator random(0UL);
+		Global::SeedStream(random, Global::Derive(runner.Seed, i));
+		RandomGenerator *previous = Global::UseStream(&random);
+		runner.Run();
+		
+		if (GetParms()->Debug)
+		{
+			stringstream ss;
+			ss << endl << Problem->ToString() << " run=" << i << endl ;
+			Debug(ss.str());
+		}
+
+		PreRun(runner);
+		while (!runner.IsDone()) 
+		{
+			fitness = Iterate(runner);
+			runner.Update(fitness);
+			Print(runner);
+			runner.Iterate();
+		}
+		PostRun();
+		Print(runner);
+		Global::UseStream(previous);
+	}
+
+	// Runs the replicates on threads threads, each with a replica of this engine that takes the next replicate left.
+	// Replicate i runs on a copy of runner and the results are added in replicate order, so a run limited by
+	// iterations gives the same result for any number of threads.  Returns false, having run nothing, if the engine
+	// has no replicas.
+	inline bool RunConcurrently(Runner& runner, Result& result, int threads)
+	{
+		vector<Algorithm*> replicas;
+		for (int m=0; m<threads; ++m)
+		{
+			Algorithm *replica = Replica();
+			if (replica == NULL)
+				break;
+			replica->Problem = Problem;
+			replicas.push_back(replica);
+		}
+		int n = (int)replicas.size();
+		if (n < threads)
+		{
+			for (int m=0; m<n; ++m)
+				delete replicas[m];
+			return false;
+		}
+
+		vector<Runner*> runs(runner.Runs);
+		for (int i=0; i<runner.Runs; ++i)
+			runs[i] = new Runner(runner);
+		atomic<int> next(0);
+		Crew crew(threads);
+		crew.Run([&](int m)
+		{
+			for (int i; (i = next++) < runner.Runs; )
+				replicas[m]->Replicate(*runs[i], i);
+		});
+
+		for (int i=0; i<runner.Runs; ++i)
+		{
+			result.Add(*runs[i]);
+			delete runs[i];
+		}
+		for (int m=0; m<threads; ++m)
+			delete replicas[m];
+		return true;
+	}
+
 	inline void Print(Runner &runner)
 	{
 		if (runner.Runs != 1 || Fitness == runner.GetFitness()) return;
@@ -88,6 +153,9 @@ public:
 
 	virtual inline void CreateParms(bool deleteOld = true) = 0;
 	virtual inline AlgoParms *GetParms() = 0;
+	// New engine with the same parameters and no shared state, to run replicates alongside this one; NULL if the
+	// parameters hold objects that cannot be copied.
+	virtual inline Algorithm* Replica() { return NULL; }
 	virtual inline void PreRun(Runner& runner) {};
 	virtual inline double Iterate(Runner& runner) = 0;
 	virtual inline void PostRun() {};
@@ -123,9 +191,12 @@ class BasicGLS : public Algorithm
 {
 	public:
 	GLSParms *Parms;
-	Solution *Best, *Current;
+	BestTracker *Best;
+	Solution *Current;
 	int n;
-	double **Penalty, **Delta;
+	Matrix Penalty;
+	DeltaMatrix Delta;
+	FeatureCosts Features;
 	double lambda; 
 
 	BasicGLS() { CreateParms(false); }
@@ -134,25 +205,28 @@ class BasicGLS : public Algorithm
 	inline void CreateParms(bool deleteOld = true) { if (deleteOld) delete Parms; Parms = new GLSParms(); }
 
 	inline AlgoParms *GetParms() { return Parms; }
+	inline Algorithm* Replica() { BasicGLS *replica = new BasicGLS(); delete replica->Parms; replica->Parms = Parms->Clone(); return replica; }
 	
 	inline void PreRun(Runner& runner)
 	{
 		n = Problem->Size;
 		Parms->Calculate(n);
-		Best = new Solution(runner.Problem);
-		Best->GetFitness();
-		Current = new Solution(*Best);  // current solution
-		Penalty = Global::CreateMatrix(n, 0);  // Penalty values of all assignments
-		Delta = Global::CreateMatrix(n);
+		Current = new Solution(runner.Problem);  // current solution
+		Best = new BestTracker(*Current);
+		Current->CachePermutedFlow();
+		Global::CreateMatrix(Penalty, n, 0);  // Penalty values of all assignments
+		Global::CreateMatrix(Delta, n);
 		Current->SwapCostMatrix(Delta);
+		Features.Track(*Current);
 		lambda = GetLambda();
 	}
 	inline void PostRun()
 	{
 		delete Best;
 		delete Current;
-		Global::DeleteMatrix(Penalty, n);
-		Global::DeleteMatrix(Delta,n);
+		Global::DeleteMatrix(Penalty);
+		Global::DeleteMatrix(Delta);
+		Features.Delete();
 	}
 
 	inline double GetLambda()
@@ -179,15 +253,12 @@ class BasicGLS : public Algorithm
 
 	inline void UpdatePenalties()
 	{
-		double costOfFeatureI, utility;
+		double utility;
 		int iBest; 
 		double max = Global::Min;
 		for (int i=0; i<n; ++i)
 		{
-			costOfFeatureI = 0;
-			for (int j=0; j<n; ++j)
-				costOfFeatureI += Problem->Distance[i][j] * Problem->Flow[(*Current)[i]][(*Current)[j]];
-			utility = costOfFeatureI / (1 + Penalty[i][(*Current)[i]]);
+			utility = Features[i] / (1 + Penalty[i][(*Current)[i]]);
 			if (utility > max)
 			{
 				max = utility;
@@ -205,6 +276,7 @@ class BasicGLS : public Algorithm
 		int iBest, jBest;
 		double min, cost;
 		int lastSteepestDescentIteration = 0;
+		int ties = 0;
 		do
 		{
 			min = Global::Max;
@@ -213,22 +285,24 @@ class BasicGLS : public Algorithm
 				for (int j = i+1; j < n; ++j)
 				{
 					cost = Delta[i][j] + lambda * (-Penalty[i][(*Current)[i]] - Penalty[j][(*Current)[j]] + Penalty[i][(*Current)[j]] + Penalty[j][(*Current)[i]]);
-					if (cost < min || cost == min && Global::Rand(2)==0) // ties are broken randomly
+					if (cost < min)
+					{
+						iBest = i; jBest = j; min = cost; ties = 1;
+					}
+					else if (cost == min && Global::Rand(++ties) == 0) // reservoir: each of the ties so far is kept with chance 1/ties
 					{
-						iBest = i; jBest = j; min = cost;
+						iBest = i; jBest = j;
 					}
 				}
 
 			if (min <= 0)
 			{
+				assert(iBest < jBest);
 				Current->Swap(iBest, jBest, &Delta[iBest][jBest]);
+				Features.Moved(iBest, jBest);
 				Current->UpdateSwapCostMatrix(Delta);	
 
-				if (Current->GetFitness() < Best->GetFitness())
-				{
-					delete Best;
-					Best = new Solution(*Current);
-				}
+				Best->Update(*Current);
 
 				if (min == 0)
 					++sideCount;
@@ -240,15 +314,27 @@ class BasicGLS : public Algorithm
 
 };
 
+// Cooperative GLS: Threads searchers, each on its own thread, descend from their own working solution and penalize
+// features of their local optima in one shared penalty memory, so each is pushed away from where the others have been
+// too.  The shared state takes only relaxed atomic updates: a searcher may see another's penalty one move late,
+// which GLS does not mind.  Each searcher keeps its own best solution and random stream and publishes its best
+// fitness to the shared one with a compare-and-swap, which is all the aspiration test and the runner need.
 class MultiGLS : public Algorithm
 {
 	public:
+	typedef BasicMatrix<atomic<int> > SharedMatrix;
 	GLSParms *Parms;
-	Solution *Best, **Current;
+	BestTracker **Best;
+	Solution **Current;
 	int n, k;
-	double **Penalty, ***Delta, **Swaps;
+	SharedMatrix Penalty, Swaps;
+	DeltaMatrix *Delta;
+	FeatureCosts *Features;
+	RandomGenerator *Random;
+	Crew Team;
+	atomic<Cost> BestFitness;
 	double lambda; 
-	int TotalSwaps;
+	atomic<int> TotalSwaps;
 
 	MultiGLS() { CreateParms(false); }
 	~MultiGLS() { delete Parms; }
@@ -264,31 +350,47 @@ class MultiGLS : public Algorithm
 		k = Parms->Threads;
 		n = Problem->Size;
 		Parms->Calculate(n);
-		Best = new Solution(runner.Problem);
-		Best->GetFitness();
 		Current = new Solution*[k];
-		Delta = new double**[k]; 
+		Current[0] = new Solution(runner.Problem);
+		Best = new BestTracker*[k];
+		Delta = new DeltaMatrix[k]; 
+		Features = new FeatureCosts[k];
+		Random = new RandomGenerator[k];
+		unsigned long long seed = Global::NewSeed();
 		for (int i=0; i<k; ++i)
 		{
-			Current[i] = new Solution(*Best); // new solution for each thread.
-			Delta[i] = Global::CreateMatrix(n);
+			if (i > 0)
+				Current[i] = new Solution(*Current[0]); // new solution for each thread.
+			Current[i]->CachePermutedFlow();
+			Best[i] = new BestTracker(*Current[i]);
+			Global::CreateMatrix(Delta[i], n);
 			Current[i]->SwapCostMatrix(Delta[i]);
+			Features[i].Track(*Current[i]);
+			Global::SeedStream(Random[i], Global::Derive(seed, i)); // searcher streams follow the replicate's, so a seeded run repeats
 		}
+		BestFitness = Current[0]->GetFitness();
 		
-		Penalty = Global::CreateMatrix(n, 0);  // Penalty values of all assignments
-		Swaps = Global::CreateMatrix(n,0);  
+		Penalty.Create(n);  // Penalty values of all assignments, zero filled
+		Swaps.Create(n);  
 		lambda = GetLambda();
 		TotalSwaps = 0;
+		Team.Create(k);
 	}
 	inline void PostRun()
 	{
-		delete Best;
-		delete [] Current;
-		Global::DeleteMatrix(Penalty, n);
+		Team.Delete();
 		for (int i=0; i<k; ++i)
-			Global::DeleteMatrix(Delta[i],n);
+		{
+			delete Best[i];
+			delete Current[i];
+		}
+		delete [] Best;
+		delete [] Current;
+		Penalty.Delete();
 		delete [] Delta;
-		Global::DeleteMatrix(Swaps,n);
+		delete [] Features;
+		delete [] Random;
+		Swaps.Delete();
 	}
 
 	inline double GetLambda()
@@ -305,37 +407,38 @@ class MultiGLS : public Algorithm
 		return a*b / pow(n,4) * Parms->Lambda;
 	}
 
+	// One round: every searcher descends and penalizes its local optimum on its own thread.  The runner is only
+	// read while the round lasts, so the searchers stop on its deadline and the caller updates it afterwards.
 	inline double Iterate(Runner& runner)
 	{
-		for (int i=0; i<k; ++i)
+		Team.Run([this, &runner](int thread)
 		{
-			LocalSearch(i, runner);
-			UpdatePenalties(i);
-		}
+			LocalSearch(thread, runner);
+			UpdatePenalties(thread);
+		});
 
-		return Best->GetFitness();
+		return BestFitness;
 	}
 
+	inline int PenaltyOf(int i, int location) const { return Penalty[i][location].load(memory_order_relaxed); }
 
 	inline void UpdatePenalties(int thread)
 	{
-		double costOfFeatureI, utility;
+		double utility;
 		int iBest; 
 		double max = Global::Min;
 		Solution &p = *Current[thread];
+		FeatureCosts &features = Features[thread];
 		for (int i=0; i<n; ++i)
 		{
-			costOfFeatureI = 0;
-			for (int j=0; j<n; ++j)
-				costOfFeatureI += Problem->Distance[i][j] * Problem->Flow[p[i]][p[j]];
-			utility = costOfFeatureI / (1 + Penalty[i][p[i]]);
+			utility = features[i] / (1 + PenaltyOf(i, p[i]));
 			if (utility > max)
 			{
 				max = utility;
 				iBest = i;
 			}
 		}
-		++Penalty[iBest][p[iBest]];
+		Penalty[iBest][p[iBest]].fetch_add(1, memory_order_relaxed);
 	}
 
 	// Find the deepest point based on augmented function h = g + penalties.  
@@ -347,18 +450,21 @@ class MultiGLS : public Algorithm
 		double min, cost;
 		int lastSteepestDescentIteration = 0;
 		Solution &p = *Current[thread];
-		double **&d = Delta[thread];
+		DeltaMatrix &d = Delta[thread];
+		RandomGenerator &random = Random[thread];
 		bool best, bestPool;
+		int ties = 0;
 		do
 		{
 			min = Global::Max;
 			best = bestPool = false;
+			Cost bestFitness = BestFitness.load(memory_order_relaxed);
 
 			for (int i = 0; i < n-1; ++i) 
 				for (int j = i+1; j < n; ++j)
 				{
 					cost = p.GetFitness() + d[i][j];
-					best = Parms->IsAspireBest && cost < Best->GetFitness();
+					best = Parms->IsAspireBest && cost < bestFitness;
 					if (best && !bestPool) { bestPool = true; min = Global::Max; sideCount=0; }
 					
 					if (!best && bestPool)
@@ -368,11 +474,15 @@ class MultiGLS : public Algorithm
 					if (bestPool)
 						cost = d[i][j];
 					else
-						cost = d[i][j] + lambda * (-Penalty[i][p[i]] - Penalty[j][p[j]] + Penalty[i][p[j]] + Penalty[j][p[i]]);
+						cost = d[i][j] + lambda * ((double)-PenaltyOf(i, p[i]) - PenaltyOf(j, p[j]) + PenaltyOf(i, p[j]) + PenaltyOf(j, p[i]));
 					
-					if (cost < min || cost == min && Global::Rand(2)==0) // ties are broken randomly
+					if (cost < min)
 					{
-						iBest = i; jBest = j; min = cost;
+						iBest = i; jBest = j; min = cost; ties = 1;
+					}
+					else if (cost == min && random.randInt(ties++) == 0) // reservoir: each of the ties so far is kept with chance 1/ties
+					{
+						iBest = i; jBest = j;
 					}
 				}
 
@@ -392,23 +502,26 @@ class MultiGLS : public Algorithm
 	inline bool TabuSearch(int thread, int swapsLeft, int tabuLength, Runner& runner)
 	{
 		bool authorized, aspired, alreadyAspired;
-		double minDelta, iBest, jBest, r;
+		Cost minDelta;
+		double iBest, jBest, r;
 		int iTabu, jTabu; 
 		bool improved = false;
 		
 		Solution &p = *Current[thread];
-		double **&d = Delta[thread];
+		DeltaMatrix &d = Delta[thread];
 		while (swapsLeft > 0 && !runner.IsDone())
 		{
 			minDelta = iBest = jBest = Global::Max; // in case all moves are tabu 
 		
 			alreadyAspired = false;
+			int totalSwaps = TotalSwaps.load(memory_order_relaxed);
+			Cost bestFitness = BestFitness.load(memory_order_relaxed);
 
 			for (int i = 0; i < n-1; ++i) 
 				for (int j = i+1; j < n; ++j)
 				{
-					authorized = Swaps[i][p[j]] <= TotalSwaps || Swaps[j][p[i]] <= TotalSwaps;
-					aspired = p.GetFitness() + d[i][j] < Best->GetFitness();                
+					authorized = Swaps[i][p[j]].load(memory_order_relaxed) <= totalSwaps || Swaps[j][p[i]].load(memory_order_relaxed) <= totalSwaps;
+					aspired = p.GetFitness() + d[i][j] < bestFitness;                
 					
 					if (aspired && !alreadyAspired || aspired && alreadyAspired && d[i][j] < minDelta || 
 						!aspired && !alreadyAspired && d[i][j] < minDelta && authorized)
@@ -423,11 +536,11 @@ class MultiGLS : public Algorithm
 			if (iBest != Global::Max) // All moves are not tabud this iteration.
 			{
 				// Forbid reverse move for a non-uniform random number of iterations (taillard update 3/13/2006)
-				r = Global::Rand();
+				r = Random[thread].rand();
 				iTabu = (int)(r*r*r*tabuLength);
-				r = Global::Rand();
+				r = Random[thread].rand();
 				jTabu = (int)(r*r*r*tabuLength);
-				if (SwapCurrent(iBest, jBest, iTabu, jTabu))
+				if (SwapCurrent(thread, iBest, jBest, iTabu, jTabu))
 					improved = true;
 				--swapsLeft; // only decrement swapsLeft if we actually swap. 
 			}
@@ -435,25 +548,31 @@ class MultiGLS : public Algorithm
 		return improved;
 	}
 
+	// Raises a shared value to at least value; concurrent raises all take effect.
+	static inline void Raise(atomic<int>& shared, int value)
+	{
+		int old = shared.load(memory_order_relaxed);
+		while (old < value && !shared.compare_exchange_weak(old, value, memory_order_relaxed));
+	}
+
 	inline bool SwapCurrent(int thread, int i, int j, int iPenalty=0, int jPenalty=0)
 	{
 		Solution &p = *Current[thread];
-		double **&d = Delta[thread];
+		DeltaMatrix &d = Delta[thread];
 
+		assert(i < j);
 		p.Swap(i, j, &d[i][j]);
-		++TotalSwaps;
+		Features[thread].Moved(i, j);
+		int totalSwaps = TotalSwaps.fetch_add(1, memory_order_relaxed) + 1;
 		p.UpdateSwapCostMatrix(d);	
-		Swaps[i][p[i]] = max<int>(Swaps[i][p[i]], TotalSwaps + iPenalty); 
-		Swaps[j][p[j]] = max<int>(Swaps[j][p[j]], TotalSwaps + jPenalty);
-
-		if (p.GetFitness() < Best->GetFitness())
-		{
-			delete Best;
-			Best = new Solution(p);
-			
-			return true;
-		}
-		return false;
+		Raise(Swaps[i][p[i]], totalSwaps + iPenalty); 
+		Raise(Swaps[j][p[j]], totalSwaps + jPenalty);
+
+		if (!Best[thread]->Update(p))
+			return false;
+		Cost fitness = p.GetFitness(), old = BestFitness.load(memory_order_relaxed);
+		while (fitness < old && !BestFitness.compare_exchange_weak(old, fitness, memory_order_relaxed));
+		return fitness < old;
 	}
 
 };
@@ -474,53 +593,87 @@ class GLS : public Algorithm
 {
 public:
 	GLSParms *Parms;
-	Solution *Best, *Current;
+	BestTracker *Best;
+	Solution *Current;
 	int n, TotalSwaps, LastSteepestDescent, LastBestMove, UniqueLocalSearches, LastUniqueLocalSearches, SwapsSinceImprovement;
-	double **Penalty, **Delta, **Swaps, *Buffer;
+	Matrix Penalty, Swaps;
+	double PenaltyScale; // the penalty of assigning i to l is Penalty[i][l] * PenaltyScale, so evaporating them all is one multiply
+	DeltaMatrix Delta;
+	TriangularMatrix<double> PenaltyDelta; // penalty part of the augmented swap cost before Lambda and PenaltyScale, (i,j) with i < j
+	bool PenaltyDeltaStale; // set when many penalties change at once; PenaltyDelta is rebuilt on its next use
+	FeatureCosts Features;
+	double *Buffer;
+	double *Draws; // random draws for one row of AugmentedScan, up to two per pair
 	double LambdaBaseSize, CurrentEvaporateSinceImproveScale; 
-	PriorityQueue<double> *BestSolutions;
+	PriorityQueue<Cost> *BestSolutions;
 
 	// Steep GLS Distance Mutation
 	int CurrentDistanceFromReference;
 	Solution *Reference;
+
+	typedef void (GLS::*ScanFunction)(int& iBest, int& jBest, double& min, int& sideCount, bool& bestPool, bool& goodPool, bool& latePool, bool& original);
+	ScanFunction Scan; // LocalSearch's pass over the pairs, compiled for the options in Parms
+
+	// TabuSearch's move choice: authorized while either assignment's Swaps entry has expired, aspired if it beats Best.
+	struct TabuCriterion : TabuSwapCriterion
+	{
+		GLS &Owner;
+		TabuCriterion(GLS& owner) : Owner(owner) {}
+		inline void operator()(int i, int j, Cost delta)
+		{
+			Solution &p = *Owner.Current;
+			bool authorized = Owner.Swaps[i][p[j]] <= Owner.TotalSwaps || Owner.Swaps[j][p[i]] <= Owner.TotalSwaps;
+			Consider(i, j, delta, authorized, p.GetFitness() + delta < Owner.Best->GetFitness());
+		}
+	};
 	
 	GLS() { CreateParms(false); }
 	~GLS() { delete Parms; }
 
 	inline void CreateParms(bool deleteOld = true) { if (deleteOld) delete Parms; Parms = new GLSParms(); }
 	inline AlgoParms *GetParms() { return Parms; }
+	inline Algorithm* Replica() { GLS *replica = new GLS(); delete replica->Parms; replica->Parms = Parms->Clone(); return replica; }
 	
 	inline void PreRun(Runner& runner)
 	{
 		TotalSwaps = 0; // number of swaps performed on current solution since the beginning. 
 		n = Problem->Size;
 		Parms->Calculate(n);
-		Best = new Solution(runner.Problem);
-		Best->GetFitness();
-		Current = new Solution(*Best);  // current solution
-		Penalty = Global::CreateMatrix(n, 0);  // Penalty values of all assignments
-		Swaps = Global::CreateMatrix(n, 0);  // History of Swaps.
-		Delta = Global::CreateMatrix(n);
+		Current = new Solution(runner.Problem);  // current solution
+		Best = new BestTracker(*Current, true);
+		Current->CachePermutedFlow();
+		Global::CreateMatrix(Penalty, n, 0);  // Penalty values of all assignments
+		PenaltyScale = 1;
+		Global::CreateMatrix(Swaps, n, 0);  // History of Swaps.
+		Global::CreateMatrix(Delta, n);
+		Global::CreateMatrix(PenaltyDelta, n);
+		PenaltyDeltaStale = true;
 		Buffer = new double[n]; 
+		Draws = new double[2*n];
 		Current->SwapCostMatrix(Delta);
+		Features.Track(*Current);
 		LambdaBaseSize = GetLambdaBaseSize();
 		LastSteepestDescent = LastBestMove = UniqueLocalSearches = SwapsSinceImprovement = 0;
 		CurrentDistanceFromReference = 0;
 		Reference = NULL;
-		BestSolutions = new PriorityQueue<double>();
+		BestSolutions = new PriorityQueue<Cost>();
 		BestSolutions->push(Best->GetFitness());
 		if (Parms->IsEvaporateSinceImprove())
 			CurrentEvaporateSinceImproveScale = Parms->EvaporateSinceImproveScale;
+		Scan = SelectScan();
 	}
 	inline void PostRun()
 	{
 		delete Best;
 		delete Current;
 		delete Reference;
-		Global::DeleteMatrix(Penalty, n);
-		Global::DeleteMatrix(Swaps,n);
-		Global::DeleteMatrix(Delta,n);
+		Global::DeleteMatrix(Penalty);
+		Global::DeleteMatrix(Swaps);
+		Global::DeleteMatrix(Delta);
+		Global::DeleteMatrix(PenaltyDelta);
+		Features.Delete();
 		delete [] Buffer;
+		delete [] Draws;
 		delete BestSolutions;
 	}
 
@@ -540,13 +693,14 @@ public:
 
 	inline double Lambda()  
 	{
-		double lambda = Parms->Lambda;
 		if (Parms->IsDynamicLambda())
-			lambda = Parms->Lambda * (1-pow(Global::Rand(),Parms->LambdaPower)); // non-uniform random values closer to lambda are generated  
-
-		return lambda * LambdaBaseSize; 
+			return LambdaFor(Global::Rand());
+		return Parms->Lambda * LambdaBaseSize; 
 	}
 
+	// Dynamic lambda for the uniform draw r: non-uniform random values closer to lambda are generated.
+	inline double LambdaFor(double r) { return Parms->Lambda * (1-pow(r,Parms->LambdaPower)) * LambdaBaseSize; }
+
 	inline double Iterate(Runner& runner)
 	{
 		if (!Parms->IsSteepMode())
@@ -643,21 +797,15 @@ public:
 	inline double* CalculateCost() { return CalculateUtilityElseCost(false); }
 	inline double* CalculateUtilityElseCost(bool isUtility)
 	{
-		double costOfFeatureI;
 		for (int i=0; i<n; ++i)
-		{
-			costOfFeatureI = 0;
-			for (int j=0; j<n; ++j)
-				costOfFeatureI += Problem->Distance[i][j] * Problem->Flow[(*Current)[i]][(*Current)[j]];
-			Buffer[i] = costOfFeatureI / (isUtility ? 1 + Penalty[i][(*Current)[i]] : 1); // if !isUtility, just calculate the cost and no denominator
-		}
+			Buffer[i] = Features[i] / (isUtility ? 1 + Penalty[i][(*Current)[i]] * PenaltyScale : 1); // if !isUtility, just calculate the cost and no denominator
 		return Buffer;
 	}
 
 	inline double* CalculatePenalty()
 	{
 		for (int i=0; i<n; ++i)
-			Buffer[i] = Penalty[i][(*Current)[i]];
+			Buffer[i] = Penalty[i][(*Current)[i]] * PenaltyScale;
 		return Buffer;
 	}
 	
@@ -671,20 +819,24 @@ public:
 	inline int AdjustSinglePenalty(bool increase, double costs[], int ignoreIndex=-1)
 	{
 		double maxx = Global::Min; 
-		int iBest;
+		int iBest, ties = 0;
 		for (int i=0; i<n; ++i)
 		{
 			if (i == ignoreIndex) continue;
-			if (costs[i] > maxx || costs[i] == maxx && Global::Rand(2)==0) 
+			if (costs[i] > maxx) 
 			{
 				maxx = costs[i];
 				iBest = i;
+				ties = 1;
 			}
+			else if (costs[i] == maxx && Global::Rand(++ties) == 0) // reservoir: each of the ties so far is kept with chance 1/ties
+				iBest = i;
 		}
 		double &p = Penalty[iBest][(*Current)[iBest]];
 		if (increase)
-			p += Parms->penaltyAmount; 
-		else p = max(0.0, p - Parms->EvaporateAmount); // No negatives allowed.
+			p += Parms->penaltyAmount / PenaltyScale; 
+		else p = max(0.0, p - Parms->EvaporateAmount / PenaltyScale); // No negatives allowed.
+		UpdatePenaltyDelta(iBest);
 		return iBest;
 	}
 
@@ -701,20 +853,57 @@ public:
 		{
 			double &p = Penalty[i][(*Current)[i]];
 			if (increase)
-				p += costs[i]/sum * Parms->penaltyAmount;
+				p += costs[i]/sum * Parms->penaltyAmount / PenaltyScale;
 			else
-				p = max(0.0, p - costs[i] / sum  * Parms->EvaporateAmount);  // No negatives allowed.   
+				p = max(0.0, p - costs[i] / sum  * Parms->EvaporateAmount / PenaltyScale);  // No negatives allowed.   
 		}
+		PenaltyDeltaStale = true;
+	}
+
+	// Penalty part of the augmented cost of swapping i and j.
+	inline double PairPenalty(int i, int j)
+	{
+		return -Penalty[i][(*Current)[i]] - Penalty[j][(*Current)[j]] + Penalty[i][(*Current)[j]] + Penalty[j][(*Current)[i]];
+	}
+
+	inline void RefreshPenaltyDelta()
+	{
+		if (!PenaltyDeltaStale) return;
+		for (int i = 0; i < n-1; ++i) 
+		{
+			double *row = PenaltyDelta[i];
+			for (int j = i+1; j < n; ++j)
+				row[j] = PairPenalty(i, j);
+		}
+		PenaltyDeltaStale = false;
+	}
+
+	// Recalculate every pair involving i, after Penalty[i][(*Current)[i]] changed or i was assigned a new location.
+	inline void UpdatePenaltyDelta(int i)
+	{
+		if (PenaltyDeltaStale) return;
+		for (int k = 0; k < i; ++k)
+			PenaltyDelta[k][i] = PairPenalty(k, i);
+		double *row = PenaltyDelta[i];
+		for (int k = i+1; k < n; ++k)
+			row[k] = PairPenalty(i, k);
+	}
+
+	// Without a swap budget.  (A default of Global::Max for swapsLeft would count the swaps down on Global::Max itself.)
+	inline bool LocalSearch(Runner& runner)
+	{
+		int swapsLeft = Global::Max;
+		return LocalSearch(runner, swapsLeft);
 	}
 
 	// Find the deepest point based on augmented function h = g + penalties.  
 	// returns true if new global best solution found.
-	inline bool LocalSearch(Runner& runner, int& swapsLeft=Global::Max)
+	inline bool LocalSearch(Runner& runner, int& swapsLeft)
 	{
 		int sideCount = 0;
 		int iBest, jBest;
-		double min, cost;
-		bool isSwap, bestPool, latePool, best, good, goodPool, late, original, randMove, bestMove;
+		double min;
+		bool isSwap, bestPool, latePool, goodPool, original, randMove, bestMove;
 		bool improvedBest = false;
 		// DOuble check if a variable initialized here should be initialized class wide instead.
 
@@ -725,13 +914,14 @@ public:
 		do
 		{
 			min = Global::Max;
-			best = bestPool = late = latePool = good = goodPool = original = randMove = bestMove = false;
+			bestPool = latePool = goodPool = original = randMove = bestMove = false;
 
 			if (Parms->IsRandomMove() && Global::Rand() < Parms->RandomMovePr)
 			{
 				randMove = true;
 				iBest = Global::Rand(n); 
 				while ((jBest=Global::Rand(n))==iBest);
+				if (iBest > jBest) swap(iBest, jBest); // only Delta[i][j] with i < j is kept
 			}
 			else if (Parms->IsBestMoveInterval() && TotalSwaps-LastBestMove > Parms->bestMoveInterval
 				  || Parms->IsBestMovePr() && Global::Rand() < Parms->BestMovePr) 
@@ -746,49 +936,7 @@ public:
 						}
 			}
 			else
-			{
-				for (int i = 0; i < n-1; ++i) 
-					for (int j = i+1; j < n; ++j)
-					{
-						cost = Current->GetFitness() + Delta[i][j];
-						best = Parms->IsAspireBest && cost < Best->GetFitness();
-						if (best && !bestPool) { bestPool = true; min = Global::Max; sideCount=0; }
-					
-						good = false;
-						if (Parms->IsAspireGood() && !bestPool)
-						{
-							if (cost < BestSolutions->top() || BestSolutions->size() < Parms->aspireGood) // do not aspireGood if the fitness already equals one of the good list fitnesses -- we don't want to allow cycles and repeat solutions. 
-							{
-								//vector<double> *v = reinterpret_cast<vector<double> *>(&BestSolutions); // cast to the priority queue base vector to allow iteration.  
-								bool found = false;
-								for (PriorityQueue<double>::iterator i=BestSolutions->begin(); i!=BestSolutions->end(); ++i)
-									if (cost == *i) { found = true; break; }
-								good = !found;
-							}
-						}
-						if (good && !goodPool) { goodPool = true; min = Global::Max; sideCount=0; } 
-
-						late = Parms->IsAspireLate() && !bestPool && !goodPool && (Swaps[i][(*Current)[j]] < TotalSwaps - Parms->aspireLate || Swaps[j][(*Current)[i]] < TotalSwaps - Parms->aspireLate);
-						if (late && !latePool) { latePool = true; min = Global::Max; sideCount=0; }
-
-						original = !bestPool && !latePool && !goodPool;
-						if (!best && bestPool || !good && goodPool && !bestPool || !late && latePool && !bestPool && !goodPool)
-							continue; // skip cost test if we're in a pool and this swap doesn't belong in the pool.
-
-						// augmented cost is the difference between the augmented functions before and after a swap (Delta H)
-						if (bestPool || latePool || goodPool)
-							cost = Delta[i][j];
-						else if (Parms->IsPenaltyNoise())
-							cost = Delta[i][j] + Lambda() * (-Penalty[i][(*Current)[i]] - Penalty[j][(*Current)[j]] + (1 - Global::Rand()*Parms->PenaltyNoisePr)*(Penalty[i][(*Current)[j]] + Penalty[j][(*Current)[i]]));
-						else
-							cost = Delta[i][j] + Lambda() * (-Penalty[i][(*Current)[i]] - Penalty[j][(*Current)[j]] + Penalty[i][(*Current)[j]] + Penalty[j][(*Current)[i]]);
-					
-						if (cost < min || cost == min && Global::Rand(2)==0) // ties are broken randomly
-						{
-							iBest = i; jBest = j; min = cost;
-						}
-					}
-			}
+				(this->*Scan)(iBest, jBest, min, sideCount, bestPool, goodPool, latePool, original);
 
 			if (min <= 0 && original || bestPool || latePool || goodPool || randMove || bestMove && min < 0)
 			{
@@ -831,87 +979,169 @@ public:
 		return improvedBest;
 	}
 
-	// Reduce all penalties by scale*100 percent.  
+	// One pass of LocalSearch over all pairs for the augmented move, with the options of Parms that the pass tests
+	// as template arguments, so each configuration is compiled into a loop holding only the tests it uses.  The
+	// aspiration pools work as before: entering one restarts the choice among the pairs that belong to it.
+	template<bool AspireBest, bool AspireGood, bool AspireLate, bool Noise, bool DynamicLambda>
+	inline void AugmentedScan(int& iBest, int& jBest, double& min, int& sideCount, bool& bestPool, bool& goodPool, bool& latePool, bool& original)
+	{
+		bool best = false, good = false, late = false;
+		Cost fitness = Current->GetFitness(), bestFitness = Best->GetFitness(), candidate; // fitness after the swap, compared exactly against the best/good solutions
+		double cost, lambda = DynamicLambda ? 0 : Lambda() * PenaltyScale; // a dynamic lambda is drawn again for every pair
+		const int draws = (DynamicLambda ? 1 : 0) + (Noise ? 1 : 0); // per pair, drawn a row at a time: lambda first, then noise
+		int ties = 0;
+		Solution &p = *Current;
+		if (!Noise)
+			RefreshPenaltyDelta();
+		for (int i = 0; i < n-1; ++i) 
+		{
+			const Cost *delta = Delta[i];
+			const double *penalty = PenaltyDelta[i];
+			if (draws > 0)
+				Global::Rand(Draws, draws * (n-1-i));
+			for (int j = i+1; j < n; ++j)
+			{
+				const double *r = Draws + draws * (j-i-1);
+				candidate = fitness + delta[j];
+				if (AspireBest)
+				{
+					best = candidate < bestFitness;
+					if (best && !bestPool) { bestPool = true; min = Global::Max; sideCount=0; }
+				}
+					
+				if (AspireGood)
+				{
+					good = false;
+					if (!bestPool && (candidate < BestSolutions->top() || (int)BestSolutions->size() < Parms->aspireGood)) // do not aspireGood if the fitness already equals one of the good list fitnesses -- we don't want to allow cycles and repeat solutions. 
+					{
+						bool found = false;
+						for (PriorityQueue<Cost>::iterator i=BestSolutions->begin(); i!=BestSolutions->end(); ++i)
+							if (candidate == *i) { found = true; break; }
+						good = !found;
+					}
+					if (good && !goodPool) { goodPool = true; min = Global::Max; sideCount=0; } 
+				}
+
+				if (AspireLate)
+				{
+					late = !bestPool && !goodPool && (Swaps[i][p[j]] < TotalSwaps - Parms->aspireLate || Swaps[j][p[i]] < TotalSwaps - Parms->aspireLate);
+					if (late && !latePool) { latePool = true; min = Global::Max; sideCount=0; }
+				}
+
+				original = !bestPool && !latePool && !goodPool;
+				if ((!best && bestPool) || (!good && goodPool && !bestPool) || (!late && latePool && !bestPool && !goodPool))
+					continue; // skip cost test if we're in a pool and this swap doesn't belong in the pool.
+
+				// augmented cost is the difference between the augmented functions before and after a swap (Delta H)
+				if (!original)
+					cost = delta[j];
+				else if (Noise && DynamicLambda)
+					cost = delta[j] + LambdaFor(r[0]) * PenaltyScale * (-Penalty[i][p[i]] - Penalty[j][p[j]] + (1 - r[1]*Parms->PenaltyNoisePr)*(Penalty[i][p[j]] + Penalty[j][p[i]]));
+				else if (Noise)
+					cost = delta[j] + lambda * (-Penalty[i][p[i]] - Penalty[j][p[j]] + (1 - r[0]*Parms->PenaltyNoisePr)*(Penalty[i][p[j]] + Penalty[j][p[i]]));
+				else
+					cost = delta[j] + (DynamicLambda ? LambdaFor(r[0]) * PenaltyScale : lambda) * penalty[j];
+					
+				if (cost < min)
+				{
+					iBest = i; jBest = j; min = cost; ties = 1;
+				}
+				else if (cost == min && Global::Rand(++ties) == 0) // reservoir: each of the ties so far is kept with chance 1/ties
+				{
+					iBest = i; jBest = j;
+				}
+			}
+		}
+	}
+
+	// Parms mapped to the matching AugmentedScan, one option at a time.
+	inline ScanFunction SelectScan() { return Parms->IsAspireBest ? SelectScan<true>() : SelectScan<false>(); }
+	template<bool AspireBest>
+	inline ScanFunction SelectScan() { return Parms->IsAspireGood() ? SelectScan<AspireBest,true>() : SelectScan<AspireBest,false>(); }
+	template<bool AspireBest, bool AspireGood>
+	inline ScanFunction SelectScan() { return Parms->IsAspireLate() ? SelectScan<AspireBest,AspireGood,true>() : SelectScan<AspireBest,AspireGood,false>(); }
+	template<bool AspireBest, bool AspireGood, bool AspireLate>
+	inline ScanFunction SelectScan() { return Parms->IsPenaltyNoise() ? SelectScan<AspireBest,AspireGood,AspireLate,true>() : SelectScan<AspireBest,AspireGood,AspireLate,false>(); }
+	template<bool AspireBest, bool AspireGood, bool AspireLate, bool Noise>
+	inline ScanFunction SelectScan()
+	{
+		return Parms->IsDynamicLambda() ? &GLS::AugmentedScan<AspireBest,AspireGood,AspireLate,Noise,true> : &GLS::AugmentedScan<AspireBest,AspireGood,AspireLate,Noise,false>;
+	}
+
+	// Reduce all penalties by scale*100 percent.  Only PenaltyScale changes, which leaves PenaltyDelta valid; the
+	// scale is folded back into the penalties once it gets so small that new penalties, added as amount / PenaltyScale,
+	// would overflow.
 	inline void ReducePenaltiesBy(double scale)
 	{
 		if (scale <= 0) return;
 		if (scale > 1.0) scale = 1.0;
-		for (int i=0; i<n; ++i) 
-			for (int j=0; j<n; ++j) 
-				Penalty[i][j] *= (1-scale);
+		PenaltyScale *= (1-scale);
+		if (PenaltyScale < 1e-100)
+		{
+			for (int i=0; i<n; ++i) 
+				for (int j=0; j<n; ++j) 
+					Penalty[i][j] *= PenaltyScale;
+			PenaltyScale = 1;
+			PenaltyDeltaStale = true;
+		}
 	}
 
 	// Minimize g(x)  (Find the deepest point based on original function g)  
 	// returns true if best solution improved.
 	inline bool SteepestDescent(Runner& runner)
 	{
-		int iBest, jBest;
-		double min;
 		bool improvedBest = false;
-		do
+		MinSwapCriterion move;
+		Solution::ScanSwapCostMatrix(Delta, move);
+		while (move.Min < 0)
 		{
-			min = Global::Max;
-			for (int i = 0; i < n-1; ++i)
-				for (int j = i+1; j < n; ++j)
-					if (Delta[i][j] < min)
-					{
-						iBest = i; jBest = j; min = Delta[i][j];
-					}
-			if (min < 0)
-			{
-				if (SwapCurrent(iBest, jBest))
-					improvedBest = true;
-			}
-		} while (min < 0 && !runner.IsDone()); 
+			int i = move.I, j = move.J;
+			move.Reset();
+			if (SwapCurrent(i, j, move)) // the next move is picked while the matrix is updated
+				improvedBest = true;
+			if (runner.IsDone())
+				break;
+		}
 		return improvedBest;
 	}
 
 	// Tabu search without iteration constrained aspiration criterion (no need because we're using a perturbation method).  
 	inline bool TabuSearch(Runner& runner, int swapsLeft, int tabuLength)
 	{
-		bool authorized, aspired, alreadyAspired;
-		double minDelta, iBest, jBest, r;
-		int iTabu, jTabu; 
+		double r;
+		int iBest, jBest, iTabu, jTabu; 
 		bool improved = false;
+		TabuCriterion move(*this);
+		Solution::ScanSwapCostMatrix(Delta, move);
 		while (swapsLeft > 0 && !runner.IsDone())
 		{
-			minDelta = iBest = jBest = Global::Max; // in case all moves are tabu 
-		
-			alreadyAspired = false;
-
-			Solution &p = *Current;
-			for (int i = 0; i < n-1; ++i) 
-				for (int j = i+1; j < n; ++j)
-				{
-					authorized = Swaps[i][p[j]] <= TotalSwaps || Swaps[j][p[i]] <= TotalSwaps;
-					aspired = p.GetFitness() + Delta[i][j] < Best->GetFitness();                
-					
-					if (aspired && !alreadyAspired || aspired && alreadyAspired && Delta[i][j] < minDelta || 
-						!aspired && !alreadyAspired && Delta[i][j] < minDelta && authorized)
-					{
-						iBest = i; jBest = j; minDelta = Delta[i][j];
-						if (aspired) 
-							alreadyAspired = true;
-					}
-				}
+			if (move.I == Global::Max) // All moves are tabu and nothing changes until one is made.
+				continue;
 
-		
-			if (iBest != Global::Max) // All moves are not tabud this iteration.
-			{
-				// Forbid reverse move for a non-uniform random number of iterations (taillard update 3/13/2006)
-				r = Global::Rand();
-				iTabu = (int)(r*r*r*tabuLength);
-				r = Global::Rand();
-				jTabu = (int)(r*r*r*tabuLength);
-				if (SwapCurrent(iBest, jBest, iTabu, jTabu))
-					improved = true;
-				--swapsLeft; // only decrement swapsLeft if we actually swap. 
-			}
+			// Forbid reverse move for a non-uniform random number of iterations (taillard update 3/13/2006)
+			r = Global::Rand();
+			iTabu = (int)(r*r*r*tabuLength);
+			r = Global::Rand();
+			jTabu = (int)(r*r*r*tabuLength);
+			iBest = move.I; jBest = move.J;
+			move.Reset();
+			if (SwapCurrent(iBest, jBest, move, iTabu, jTabu))
+				improved = true;
+			--swapsLeft; // only decrement swapsLeft if we actually swap. 
 		}
 		return improved;
 	}
 
 	inline bool SwapCurrent(int i, int j, int iPenalty=0, int jPenalty=0)
+	{
+		NoSwapCriterion none;
+		return SwapCurrent(i, j, none, iPenalty, jPenalty);
+	}
+
+	// Swaps i and j and updates Delta, handing the new costs to choose once the swap history and Best already
+	// reflect the move.
+	template<typename Criterion>
+	inline bool SwapCurrent(int i, int j, Criterion& choose, int iPenalty=0, int jPenalty=0)
 	{
 		// Iteratively calculate distance from Reference solution.
 		if (Parms->Steep.IsMutateByDistance && Reference != NULL)
@@ -924,19 +1154,28 @@ public:
 			if (c[j] == r[i]) --CurrentDistanceFromReference; 
 		}
 
+		assert(i < j);
 		Current->Swap(i, j, &Delta[i][j]);
+		if (Parms->Debug && Current->GetFitness() != Current->FreshFitness())
+		{
+			cerr << "GLS swap (" << i << "," << j << ") left fitness " << Current->GetFitness() << ", should be " << Current->FreshFitness() << endl;
+			exit(1);
+		}
+		Features.Moved(i, j);
+		Best->Swapped(i, j);
+		UpdatePenaltyDelta(i);
+		UpdatePenaltyDelta(j);
 		++TotalSwaps;
-		Current->UpdateSwapCostMatrix(Delta);	
 		Swaps[i][(*Current)[i]] = max<int>(Swaps[i][(*Current)[i]], TotalSwaps + iPenalty); 
 		Swaps[j][(*Current)[j]] = max<int>(Swaps[j][(*Current)[j]], TotalSwaps + jPenalty);
 
-		if (Current->GetFitness() < Best->GetFitness())
+		if (Best->Update(*Current))
 		{
-			delete Best;
-			Best = new Solution(*Current);
 			SwapsSinceImprovement = 0;
+			Current->UpdateSwapCostMatrix(Delta, choose);
 			return true;
 		}
+		Current->UpdateSwapCostMatrix(Delta, choose);
 		
 		++SwapsSinceImprovement;
 		if (Parms->IsEvaporateSinceImprove() && SwapsSinceImprovement != 0 && SwapsSinceImprovement % Parms->evaporateSinceImproveInterval == 0)
@@ -953,77 +1192,65 @@ class TabuSearch : public Algorithm
 {
 public:
 	TabuSearchParms *Parms;
-	Solution *Best, *Current;
+	BestTracker *Best;
+	Solution *Current;
 	int n;
-	double **tabuList, **delta;
-
+	TabuMemory tabuList;
+	DeltaMatrix delta;
 
-	bool authorized;  // move not tabu?
-	bool aspired;     // move forced?
-	bool alreadyAspired;  // In case many moves forced
 	int iBest, jBest;
-	double minDelta;
+	Cost minDelta;
 	double r;
 	int run, tabu; // How many runs has there been since an improvement was found.
 	int aspireCount;
+	TabuMoveCriterion move; // picked while delta is updated after the previous move
 
-	TabuSearch() { CreateParms(false); }
+	TabuSearch() : move(tabuList) { CreateParms(false); }
 	~TabuSearch() { delete Parms; }
 
 
 	inline void CreateParms(bool deleteOld = true) { if (deleteOld) delete Parms; Parms = new TabuSearchParms(); }
 	inline AlgoParms *GetParms() { return Parms; }
+	inline Algorithm* Replica() { TabuSearch *replica = new TabuSearch(); delete replica->Parms; replica->Parms = Parms->Clone(); return replica; }
 	inline void PreRun(Runner& runner)
 	{
 		n = Problem->Size;
 		Parms->Calculate(n); 
 
-		Best = new Solution(runner.Problem);
-		Best->GetFitness();
-		Current = new Solution(*Best);  // current solution
+		Current = new Solution(runner.Problem);  // current solution
+		Best = new BestTracker(*Current);
+		Current->CachePermutedFlow();
 
-		tabuList = Global::CreateMatrix(n);  // Tabu status
-		for (int i = 0; i < n; ++i) 
-			for (int j = 0; j < n; ++j)
-				tabuList[i][j] = -(n*i + j);	
+		tabuList.Create(n);  // Tabu status
+		tabuList.Track(*Current);
 		
-		delta = Global::CreateMatrix(n);
+		Global::CreateMatrix(delta, n);
 		Current->SwapCostMatrix(delta);
 		aspireCount = 0;
+		move.Aspiration = Parms->t;
+		move.Reset(-1, *Current, Best->GetFitness());
 	}
 
 	inline void PostRun()
 	{
 		delete Best;
 		delete Current;
-		Global::DeleteMatrix(delta, n);
-		Global::DeleteMatrix(tabuList, n);
+		Global::DeleteMatrix(delta);
+		tabuList.Delete();
 	}
 
 	inline double Iterate(Runner& runner)
 	{
 		run = runner.Iteration;	
 
-		// Find best move (iBest, jBest) 
-		minDelta = iBest = jBest = Global::Max; // in case all moves are tabu 
-		alreadyAspired = false;
-
+		// Find best move (iBest, jBest), unless it was already picked during the last update
 		Solution &p = *Current;
-		for (int i = 0; i < n-1; ++i) 
-			for (int j = i+1; j < n; ++j)
-			{
-				authorized = tabuList[i][p[j]] < run || tabuList[j][p[i]] < run;
-				aspired = tabuList[i][p[j]] < run - Parms->t || tabuList[j][p[i]] < run - Parms->t || p.GetFitness() + delta[i][j] < Best->GetFitness();                
-					
-				if (aspired && !alreadyAspired || aspired && alreadyAspired && delta[i][j] < minDelta || 
-					!aspired && !alreadyAspired && delta[i][j] < minDelta && authorized)
-				{
-					iBest = i; jBest = j; minDelta = delta[i][j];
-					if (aspired) 
-						alreadyAspired = true;
-				}
-			}
-
+		if (move.Run != run)
+		{
+			move.Reset(run, p, Best->GetFitness());
+			Solution::ScanSwapCostMatrix(delta, move);
+		}
+		iBest = move.I; jBest = move.J; minDelta = move.Min;
 		
 		if (iBest != Global::Max) // All moves are not tabud this iteration.
 		{
@@ -1032,18 +1259,16 @@ public:
 			
 			// Forbid reverse move for a non-uniform random number of iterations (taillard update 3/13/2006)
 			r = Global::Rand();
-			tabuList[iBest][p[jBest]] = run + (int)(r*r*r*Parms->u);
+			tabuList.Forbid(iBest, p[jBest], run + (int)(r*r*r*Parms->u));
 			r = Global::Rand();
-			tabuList[jBest][p[iBest]] = run + (int)(r*r*r*Parms->u);
+			tabuList.Forbid(jBest, p[iBest], run + (int)(r*r*r*Parms->u));
+			tabuList.Moved(iBest, jBest);
 			
-			if (p.GetFitness() < Best->GetFitness())
-			{
-				delete Best;
-				Best = new Solution(*Current);
-			}
+			Best->Update(*Current);
 
-			// Update matrix of move costs
-			Current->UpdateSwapCostMatrix(delta);
+			// Update matrix of move costs and pick the next iteration's move
+			move.Reset(run+1, p, Best->GetFitness());
+			Current->UpdateSwapCostMatrix(delta, move);
 		}
 	
 		return Best->GetFitness();
@@ -1062,54 +1287,67 @@ class MyTabuSearch : public Algorithm
 {
 public:
 	MyTabuSearchParms *Parms;
-	Solution *Best, *Current;
+	BestTracker *Best;
+	Solution *Current;
 	int n;
-	double **tabuList, **delta;
+	TabuMemory tabuList;
+	DeltaMatrix delta;
 
 
 	bool authorized;  // move not tabu?
 	bool aspired, pureAspired;     // move forced?
 	bool alreadyAspired;  // In case many moves forced
 	int iBest, jBest;
-	double minDelta;
+	Cost minDelta;
 	double r;
 	int run, failedRuns, tabu; // How many runs has there been since an improvement was found.
 	int aspireCount;
 	Phase phase;
+	TabuMoveCriterion move;
+	typedef void (MyTabuSearch::*ChooseFunction)();
+	ChooseFunction Choose; // move choice compiled for the options in Parms, picked at PreRun
 
-	MyTabuSearch() { CreateParms(false); }
+	MyTabuSearch() : move(tabuList) { CreateParms(false); }
 	~MyTabuSearch() { delete Parms; }
 
 	inline void CreateParms(bool deleteOld = true) { if (deleteOld) delete Parms; Parms = new MyTabuSearchParms(); }
 	inline AlgoParms *GetParms() { return Parms; }
+	inline Algorithm* Replica()
+	{
+		MyTabuSearchParms *parms = Parms->Clone();
+		if (parms == NULL)
+			return NULL;
+		MyTabuSearch *replica = new MyTabuSearch();
+		delete replica->Parms;
+		replica->Parms = parms;
+		return replica;
+	}
 
 	inline void PreRun(Runner& runner)
 	{
 		n = Problem->Size;
 		Parms->Calculate(n); 
 
-		Best = new Solution(runner.Problem);
-		Best->GetFitness();
-		Current = new Solution(*Best);  // current solution
+		Current = new Solution(runner.Problem);  // current solution
+		Best = new BestTracker(*Current);
+		Current->CachePermutedFlow();
 
-		tabuList = Global::CreateMatrix(n);  // Tabu status
-		for (int i = 0; i < n; ++i) 
-			for (int j = 0; j < n; ++j)
-				tabuList[i][j] = -(n*i + j);	
+		tabuList.Create(n);  // Tabu status
 		
-		delta = Global::CreateMatrix(n);
+		Global::CreateMatrix(delta, n);
 		Current->SwapCostMatrix(delta);
 		failedRuns = 0;
 		aspireCount = 0;
 		phase = Explore;
+		Choose = Parms->Exploit == NULL ? &MyTabuSearch::ChooseMove<false> : &MyTabuSearch::ChooseMove<true>;
 	}
 
 	inline void PostRun()
 	{
 		delete Best;
 		delete Current;
-		Global::DeleteMatrix(delta, n);
-		Global::DeleteMatrix(tabuList, n);
+		Global::DeleteMatrix(delta);
+		tabuList.Delete();
 	}
 
 	inline double Iterate(Runner& runner)
@@ -1120,10 +1358,7 @@ public:
 		if (Parms->Jolt != NULL && failedRuns != 0 && failedRuns%Parms->joltRate == 0)
 		{
 			if (Parms->JoltBest)
-			{
-				delete Current;
-				Current = new Solution(*Best);
-			}
+				*Current = Best->Get();
 
 			r = Current->GetFitness();
 			Parms->Jolt->Enhance(*Current, run);
@@ -1136,6 +1371,7 @@ public:
 		{
 			delete Current;
 			Current = Parms->Constructor->Generate(*Problem);
+			Current->CachePermutedFlow();
 			Current->SwapCostMatrix(delta);
 		}
 
@@ -1222,40 +1458,7 @@ public:
 
 
 		// Find best move (iBest, jBest) 
-		iBest = Global::Max; // in case all moves are tabu
-		jBest = Global::Max;
-		minDelta = Global::Max;
-		alreadyAspired = false;
-
-		aspireCount = 0;
-
-		for (int i = 0; i < n-1; ++i) 
-			for (int j = i+1; j < n; ++j)
-			{
-				authorized = tabuList[i][(*Current)[j]] < run || tabuList[j][(*Current)[i]] < run;
-				pureAspired = tabuList[i][(*Current)[j]] < run - Parms->t || tabuList[j][(*Current)[i]] < run - Parms->t;
-				
-				if (Parms->Exploit != NULL && phase == Exploit && pureAspired) // In exploit phase => ignore any pure aspirations and defer aspiring until later.
-				{
-					pureAspired = false;
-					if (tabuList[i][(*Current)[j]] < run - Parms->t) 
-						tabuList[i][(*Current)[j]] = min((int)tabuList[i][(*Current)[j]] + Parms->defer, run); // do not defer past current iteration! We do not want to forbid access to it!
-					if (tabuList[j][(*Current)[i]] < run - Parms->t)
-						tabuList[j][(*Current)[i]] = min((int)tabuList[j][(*Current)[i]] + Parms->defer, run); // do not defer past current iteration! We do not want to forbid access to it!
-				}
-				aspired = pureAspired || Current->GetFitness() + delta[i][j] < Best->GetFitness();                
-				
-				if (aspired && !alreadyAspired || aspired && alreadyAspired && delta[i][j] < minDelta || 
-					!aspired && !alreadyAspired && delta[i][j] < minDelta && authorized)
-				{
-					iBest = i; jBest = j; minDelta = delta[i][j];
-					if (aspired) 
-						alreadyAspired = true;
-				}
-
-				if (pureAspired) 
-					++aspireCount;
-			}
+		(this->*Choose)();
 
 		if (iBest != Global::Max) // All moves are not tabud this iteration.
 		{
@@ -1266,11 +1469,11 @@ public:
 			// Forbid reverse move for a non-uniform random number of iterations (taillard update 3/13/2006)
 			r = Global::Rand();
 			tabu = run + (int)(r*r*r*Parms->u);
-			tabuList[iBest][ (*Current)[jBest] ] = tabu; 
+			tabuList.Forbid(iBest, (*Current)[jBest], tabu); 
 			
 			r = Global::Rand();
 			tabu = run + (int)(r*r*r*Parms->u);
-			tabuList[jBest][ (*Current)[iBest] ] = tabu;
+			tabuList.Forbid(jBest, (*Current)[iBest], tabu);
 
 			// Update frequency matrix 
 			if (Parms->Constructor != NULL)
@@ -1280,11 +1483,8 @@ public:
 			}
 
 			// Best solution improved ?
-			if (Current->GetFitness() < Best->GetFitness())
-			{
-				Best = new Solution(*Current);
+			if (Best->Update(*Current))
 				failedRuns = 0;
-			}
 			else   
 				++failedRuns; 
 
@@ -1331,6 +1531,67 @@ public:
 		return Best->GetFitness();
 	}
 
+	// Without exploit phases the choice is the plain robust tabu search one and needs no aspiration counting.
+	template<bool Exploiting>
+	inline void ChooseMove()
+	{
+		aspireCount = 0;
+		if (!Exploiting)
+		{
+			move.Aspiration = Parms->t;
+			move.Reset(run, *Current, Best->GetFitness());
+			Solution::ScanSwapCostMatrix(delta, move);
+			iBest = move.I; jBest = move.J; minDelta = move.Min;
+			return;
+		}
+		phase == Exploit ? ExploitScan<true>() : ExploitScan<false>();
+	}
+
+	// Robust tabu search choice that counts pure aspirations; while Deferring (the exploit phase) they are not
+	// taken but pushed back by defer iterations.
+	template<bool Deferring>
+	inline void ExploitScan()
+	{
+		Solution &p = *Current;
+		Cost fitness = p.GetFitness(), bestFitness = Best->GetFitness();
+		int aged = run - Parms->t;
+		iBest = Global::Max; // in case all moves are tabu
+		jBest = Global::Max;
+		minDelta = Global::Max;
+		alreadyAspired = false;
+		for (int i = 0; i < n-1; ++i) 
+		{
+			const Cost *row = delta[i];
+			for (int j = i+1; j < n; ++j)
+			{
+				int ti = tabuList.Until(i, p[j]), tj = tabuList.Until(j, p[i]);
+				authorized = ti < run || tj < run;
+				pureAspired = ti < aged || tj < aged;
+				
+				if (Deferring && pureAspired) // In exploit phase => ignore any pure aspirations and defer aspiring until later.
+				{
+					pureAspired = false;
+					if (ti < aged) 
+						tabuList.Forbid(i, p[j], min(ti + Parms->defer, run)); // do not defer past current iteration! We do not want to forbid access to it!
+					if (tj < aged)
+						tabuList.Forbid(j, p[i], min(tj + Parms->defer, run)); // do not defer past current iteration! We do not want to forbid access to it!
+				}
+				aspired = pureAspired || fitness + row[j] < bestFitness;                
+				
+				if ((aspired && !alreadyAspired) || (aspired && alreadyAspired && row[j] < minDelta) || 
+					(!aspired && !alreadyAspired && row[j] < minDelta && authorized))
+				{
+					iBest = i; jBest = j; minDelta = row[j];
+					if (aspired) 
+						alreadyAspired = true;
+				}
+
+				if (!Deferring && pureAspired) 
+					++aspireCount;
+			}
+		}
+	}
+
 
 
 };
@@ -1340,54 +1601,70 @@ class CoreTS : public Algorithm
 {
 public:
 	MyTabuSearchParms *Parms;
-	Solution *Best, *Current;
+	BestTracker *Best;
+	Solution *Current;
 	int n;
-	double **tabuList, **delta;
+	TabuMemory tabuList;
+	DeltaMatrix delta;
 
 
 	bool authorized;  // move not tabu?
 	bool aspired;     // move forced?
 	bool alreadyAspired;  // In case many moves forced
 	int iBest, jBest;
-	double minDelta;
+	Cost minDelta;
 	double r;
 	Phase phase;
 	int run, failedRuns, tabu; // How many runs has there been since an improvement was found.
 
 	bool isCoreTabu;
+	TabuMoveCriterion move;
+	int *Free; // positions outside the core, gathered once per core phase iteration
+	typedef void (CoreTS::*ChooseFunction)();
+	ChooseFunction Choose; // move choice compiled for the options in Parms, picked at PreRun
 
-	CoreTS() { CreateParms(false); }
+	CoreTS() : move(tabuList) { CreateParms(false); }
 	~CoreTS() { delete Parms; }
 
 
 	inline void CreateParms(bool deleteOld = true) { if (deleteOld) delete Parms; Parms = new MyTabuSearchParms(); }
 	inline AlgoParms *GetParms() { return Parms; }
+	inline Algorithm* Replica()
+	{
+		MyTabuSearchParms *parms = Parms->Clone();
+		if (parms == NULL)
+			return NULL;
+		CoreTS *replica = new CoreTS();
+		delete replica->Parms;
+		replica->Parms = parms;
+		return replica;
+	}
 	inline void PreRun(Runner& runner)
 	{
 		n = Problem->Size;
 		Parms->Calculate(n); 
 
-		Best = new Solution(runner.Problem);
-		Best->GetFitness();
-		Current = new Solution(*Best);  // current solution
+		Current = new Solution(runner.Problem);  // current solution
+		Best = new BestTracker(*Current);
+		Current->CachePermutedFlow();
 
-		tabuList = Global::CreateMatrix(n);  // Tabu status
-		for (int i = 0; i < n; ++i) 
-			for (int j = 0; j < n; ++j)
-				tabuList[i][j] = -(n*i + j);	
+		tabuList.Create(n);  // Tabu status
 		
-		delta = Global::CreateMatrix(n);
+		Global::CreateMatrix(delta, n);
 		Current->SwapCostMatrix(delta);
 		failedRuns = 0;
 		phase = Work;
+		Free = new int[n];
+		Choose = Parms->CoreSize == NULL ? &CoreTS::ChooseMove<false> : &CoreTS::ChooseMove<true>;
 	}
 
 	inline void PostRun()
 	{
 		delete Best;
 		delete Current;
-		Global::DeleteMatrix(delta, n);
-		Global::DeleteMatrix(tabuList, n);
+		Global::DeleteMatrix(delta);
+		tabuList.Delete();
+		delete [] Free;
 	}
 
 	inline double Iterate(Runner& runner)
@@ -1422,33 +1699,7 @@ public:
 		}
 
 		// Find best move (iBest, jBest) 
-		iBest = Global::Max; // in case all moves are tabu 
-		jBest = Global::Max;
-		minDelta = Global::Max;
-		alreadyAspired = false; 
-
-		for (int i = 0; i < n-1; ++i) 
-		{
-			if (Parms->CoreSize != NULL && phase == Core && Parms->CoreConstructor->IsInCore(i, (*Current)[i])) // Component at i is part of the core, so skip this i.
-				continue;
-
-			for (int j = i+1; j < n; ++j)
-			{
-				if (Parms->CoreSize != NULL && phase == Core && Parms->CoreConstructor->IsInCore(j, (*Current)[j])) // Component at j is part of the core, so skip this j.
-					continue;
-				
-				authorized = tabuList[i][(*Current)[j]] < run || tabuList[j][(*Current)[i]] < run;
-				aspired = tabuList[i][(*Current)[j]] < run - Parms->t || tabuList[j][(*Current)[i]] < run - Parms->t || Current->GetFitness() + delta[i][j] < Best->GetFitness();                
-					
-				if (aspired && !alreadyAspired || aspired && alreadyAspired && delta[i][j] < minDelta || 
-					!aspired && !alreadyAspired && delta[i][j] < minDelta && authorized)
-				{
-					iBest = i; jBest = j; minDelta = delta[i][j];
-					if (aspired) 
-						alreadyAspired = true;
-				}
-			}
-		}
+		(this->*Choose)();
 
 		if (iBest == Global::Max) 
 			return Best->GetFitness(); //  All moves are tabu this iteration!
@@ -1459,11 +1710,11 @@ public:
 		// Forbid reverse move for a non-uniform random number of iterations (taillard update 3/13/2006)
 		r = Global::Rand();
 		tabu = run + (int)(r*r*r*Parms->u);
-		tabuList[iBest][ (*Current)[jBest] ] = tabu; 
+		tabuList.Forbid(iBest, (*Current)[jBest], tabu); 
 			
 		r = Global::Rand();
 		tabu = run + (int)(r*r*r*Parms->u);
-		tabuList[jBest][ (*Current)[iBest] ] = tabu;
+		tabuList.Forbid(jBest, (*Current)[iBest], tabu);
 
 		if (Parms->CoreSize != NULL && phase == Work)
 		{
@@ -1472,11 +1723,8 @@ public:
 		}
 			
 		// Best solution improved ?
-		if (Current->GetFitness() < Best->GetFitness())
-		{
-			Best = new Solution(*Current);
+		if (Best->Update(*Current))
 			failedRuns = 0;
-		}
 		else  
 			++failedRuns; 
 
@@ -1486,6 +1734,56 @@ public:
 		return Best->GetFitness();
 	}
 
+	// Outside core phases (and always without a core) the choice is the plain robust tabu search one.
+	template<bool Cored>
+	inline void ChooseMove()
+	{
+		if (!Cored || phase != Core)
+		{
+			move.Aspiration = Parms->t;
+			move.Reset(run, *Current, Best->GetFitness());
+			Solution::ScanSwapCostMatrix(delta, move);
+			iBest = move.I; jBest = move.J; minDelta = move.Min;
+			return;
+		}
+		CoreScan();
+	}
 
+	// Robust tabu search choice among the pairs of positions whose component is not part of the core.  The core is
+	// looked up once per position instead of twice per pair, and core positions drop out of the loops entirely.
+	inline void CoreScan()
+	{
+		Solution &p = *Current;
+		int m = 0;
+		for (int i = 0; i < n; ++i)
+			if (!Parms->CoreConstructor->IsInCore(i, p[i]))
+				Free[m++] = i;
 
+		Cost fitness = p.GetFitness(), bestFitness = Best->GetFitness();
+		int aged = run - Parms->t;
+		iBest = Global::Max; // in case all moves are tabu 
+		jBest = Global::Max;
+		minDelta = Global::Max;
+		alreadyAspired = false; 
+		for (int a = 0; a < m-1; ++a) 
+		{
+			int i = Free[a];
+			const Cost *row = delta[i];
+			for (int b = a+1; b < m; ++b)
+			{
+				int j = Free[b];
+				int ti = tabuList.Until(i, p[j]), tj = tabuList.Until(j, p[i]);
+				authorized = ti < run || tj < run;
+				aspired = ti < aged || tj < aged || fitness + row[j] < bestFitness;                
+					
+				if ((aspired && !alreadyAspired) || (aspired && alreadyAspired && row[j] < minDelta) || 
+					(!aspired && !alreadyAspired && row[j] < minDelta && authorized))
+				{
+					iBest = i; jBest = j; minDelta = row[j];
+					if (aspired) 
+						alreadyAspired = true;
+				}
+			}
+		}
+	}
 };
@@ -0,0 +1,127 @@
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <time.h>
+#include <atomic>
+#include "Global.cpp"
+#include "Instance.cpp"
+#include "Solution.cpp"
+#include "TabuMemory.cpp"
+
+using namespace std;
+
+// Steady-state throughput of the core move loops, independent of any algorithm's parameters.  A cached working
+// solution updates its swap cost matrix after every move with the next move picked on the way: first taking the best
+// swap, or a random one from a local optimum so it never stalls, then as a robust tabu search with the tabu memory
+// tracking it.  Prints moves per second of each loop for each instance, and heap allocations per move when built
+// with -DQAP_COUNT_ALLOCATIONS (which replaces the global operator new in Main.cpp).
+class Benchmark
+{
+private:
+	static inline void Header()
+	{
+		cout << setw(10) << "instance" << setw(6) << "n" << setw(14) << "moves/s" << setw(14) << "tabu moves/s";
+#ifdef QAP_COUNT_ALLOCATIONS
+		cout << setw(14) << "allocs/move";
+#endif
+		cout << endl;
+	}
+
+	static inline void Measure(Instance& problem, int seconds)
+	{
+		int n = problem.Size, moves = 0, tabuMoves = 0, iteration = 0; // iteration is the tabu clock, all-tabu ones included
+		Solution current(problem);
+		current.CachePermutedFlow();
+		current.GetFitness();
+		DeltaMatrix delta(n);
+		current.SwapCostMatrix(delta);
+		MinSwapCriterion move;
+		Solution::ScanSwapCostMatrix(delta, move);
+		TabuMemory tabu(n);
+		tabu.Track(current);
+		TabuMoveCriterion tabuMove(tabu, 5*n*n); // Taillard's aspiration; tabu durations are drawn up to n below
+		Cost best = current.GetFitness();
+
+#ifdef QAP_COUNT_ALLOCATIONS
+		size_t allocations = Allocations;
+#endif
+		clock_t start = clock(), stop = start + (clock_t)seconds * CLOCKS_PER_SEC;
+		do
+		{
+			for (int m=0; m<64; ++m, ++moves)
+			{
+				int i = move.I, j = move.J;
+				if (move.Min >= 0)
+				{
+					i = Global::Rand(n);
+					while ((j=Global::Rand(n))==i);
+					if (i > j) swap(i, j);
+				}
+				move.Reset();
+				current.Swap(i, j, &delta[i][j]);
+				current.UpdateSwapCostMatrix(delta, move);
+			}
+		} while (clock() < stop);
+		double elapsed = double(clock() - start) / CLOCKS_PER_SEC;
+
+		tabuMove.Reset(0, current, best);
+		Solution::ScanSwapCostMatrix(delta, tabuMove);
+		clock_t tabuStart = clock();
+		stop = tabuStart + (clock_t)seconds * CLOCKS_PER_SEC;
+		do
+		{
+			for (int m=0; m<64; ++m, ++iteration)
+			{
+				int i = tabuMove.I, j = tabuMove.J;
+				if (i == Global::Max) // everything tabu: nothing changes until the next iteration
+				{
+					tabuMove.Reset(iteration+1, current, best);
+					Solution::ScanSwapCostMatrix(delta, tabuMove);
+					continue;
+				}
+				current.Swap(i, j, &delta[i][j]);
+				double r = Global::Rand();
+				tabu.Forbid(i, current[j], iteration + (int)(r*r*r*n));
+				r = Global::Rand();
+				tabu.Forbid(j, current[i], iteration + (int)(r*r*r*n));
+				tabu.Moved(i, j);
+				best = min(best, current.GetFitness());
+				tabuMove.Reset(iteration+1, current, best);
+				current.UpdateSwapCostMatrix(delta, tabuMove);
+				++tabuMoves;
+			}
+		} while (clock() < stop);
+		double tabuElapsed = double(clock() - tabuStart) / CLOCKS_PER_SEC;
+
+		cout << setw(10) << problem.InstanceName << setw(6) << n << setw(14) << int(moves / elapsed) << setw(14) << int(tabuMoves / tabuElapsed);
+#ifdef QAP_COUNT_ALLOCATIONS
+		cout << setw(14) << double(Allocations - allocations) / (moves + tabuMoves);
+#endif
+		cout << endl;
+	}
+public:
+#ifdef QAP_COUNT_ALLOCATIONS
+	static atomic<size_t> Allocations; // operator new calls so far, counted by the replacement operator new in Main.cpp
+#endif
+
+	static void Run(vector<Instance*>& instances, int seconds)
+	{
+		Header();
+		for (int k=0; k<(int)instances.size(); ++k)
+			Measure(*instances[k], seconds);
+	}
+
+	// The same loops on random instances of growing size, to show how throughput holds up once the swap cost matrix,
+	// the tabu memory and the instance matrices no longer fit in cache together.
+	static void Scaling(int seconds)
+	{
+		int sizes[] = { 16, 32, 64, 96, 128, 192, 256, 384, 512 };
+		Header();
+		for (int k=0; k<(int)(sizeof(sizes)/sizeof(int)); ++k)
+		{
+			Instance problem(sizes[k]);
+			Measure(problem, seconds);
+		}
+	}
+};
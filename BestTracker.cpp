@@ -0,0 +1,86 @@
+#pragma once
+#include <cstring>
+#include "Solution.cpp"
+
+// Best solution found by a search, held in one Solution allocated per run and updated in place on improvement.
+// In lazy mode an improvement only marks how far along the trail of the tracked solution's swaps the best one lies,
+// and the permutation is built by replaying that prefix when it is asked for (Get) or when the trail fills up.
+// Lazy tracking needs every swap of the tracked solution reported through Swapped, so only engines that change
+// their working solution in one place should use it.
+class BestTracker
+{
+private:
+	Solution Best;
+	int *Trail;   // swaps (Trail[2k], Trail[2k+1]) made by the tracked solution since Best was last brought up to date
+	int Length, BestLength, Capacity;
+	bool Following; // Trail holds every swap since then, so replaying it on Best reproduces the tracked solution
+	bool Lazy;
+	Cost Fitness;
+	BestTracker(const BestTracker&);
+	BestTracker& operator=(const BestTracker&);
+
+	// Replays the swaps up to the best solution onto Best and drops them from the trail.
+	inline void Materialize()
+	{
+		if (BestLength == 0) return;
+		for (int k=0; k<BestLength; ++k)
+			Best.Swap(Trail[2*k], Trail[2*k+1], NULL);
+		Best.SetFitness(Fitness);
+		Length -= BestLength;
+		memmove(Trail, Trail + 2*BestLength, 2*Length*sizeof(int));
+		BestLength = 0;
+	}
+public:
+	BestTracker(Solution& current, bool lazy=false) : Best(current), Trail(NULL), Length(0), BestLength(0), Capacity(lazy ? current.Size() : 0),
+		Following(lazy), Lazy(lazy), Fitness(current.GetFitness())
+	{
+		if (lazy)
+			Trail = new int[2*Capacity];
+	}
+	~BestTracker() { delete [] Trail; }
+
+	inline Cost GetFitness() { return Fitness; }
+
+	// Takes current as the best solution if it is strictly better; returns true if it was.
+	inline bool Update(Solution& current)
+	{
+		Cost fitness = current.GetFitness();
+		if (fitness >= Fitness)
+			return false;
+		Fitness = fitness;
+		if (Following)
+			BestLength = Length;
+		else
+		{
+			Best = current;
+			Length = BestLength = 0;
+			Following = Lazy;
+		}
+		return true;
+	}
+
+	// Records a swap of the tracked solution (lazy mode; a no-op otherwise).
+	inline void Swapped(int i, int j)
+	{
+		if (!Following) return;
+		if (Length == Capacity)
+		{
+			Materialize();
+			if (Length == Capacity) // no improvement for a whole trail: stop following, the next one is copied
+			{
+				Following = false;
+				Length = 0;
+				return;
+			}
+		}
+		Trail[2*Length] = i;
+		Trail[2*Length+1] = j;
+		++Length;
+	}
+
+	inline Solution& Get()
+	{
+		Materialize();
+		return Best;
+	}
+};
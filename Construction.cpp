@@ -46,29 +46,26 @@ class RandomConstruct : public Construction
 class EdgeCountConstruct : public Construction
 {
 	int *Total;
-	double **Counts;
+	Matrix Counts;
 public:
 	int Size;
 	bool isEmpty;
-	EdgeCountConstruct() : isEmpty(true), Total(NULL), Size(0), Counts(NULL) {}
+	EdgeCountConstruct() : isEmpty(true), Total(NULL), Size(0) {}
 	~EdgeCountConstruct() 
 	{ 
-		if (Counts) 
-			Global::DeleteMatrix(Counts, Size);
 		delete [] Total;
 	}
 
 	inline void Initialize(int size)
 	{
 		isEmpty = true;
-		Global::DeleteMatrix(Counts, Size);
 		delete [] Total;
 
 		Size = size;
 		Total = new int[size];
 		for (int i=0; i<size; ++i)
 				Total[i] = 0;
-		Counts = Global::CreateMatrix(size,0);
+		Global::CreateMatrix(Counts, size, 0);
 	}
 
 
@@ -121,16 +118,14 @@ public:
 class CoreConstruct : public Construction
 {
 	int *Total;
-	double **Counts;
+	Matrix Counts;
 public:
 	int* Core;
 	int Size;
 	bool isEmpty;
-	CoreConstruct() : Core(NULL), isEmpty(true), Total(NULL), Size(0), Counts(NULL) {}
+	CoreConstruct() : Core(NULL), isEmpty(true), Total(NULL), Size(0) {}
 	~CoreConstruct() 
 	{ 
-		if (Counts) 
-			Global::DeleteMatrix(Counts, Size);
 		delete [] Total;
 		delete [] Core;
 	}
@@ -138,7 +133,6 @@ public:
 	inline void Initialize(int size)
 	{
 		isEmpty = true;
-		Global::DeleteMatrix(Counts, Size);
 		delete [] Total;
 		delete [] Core;
 
@@ -146,7 +140,7 @@ public:
 		Total = new int[size];
 		for (int i=0; i<size; ++i)
 				Total[i] = 0;
-		Counts = Global::CreateMatrix(size,0);
+		Global::CreateMatrix(Counts, size, 0);
 		Core = new int[size];
 	}
 
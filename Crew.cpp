@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+// Fixed group of threads that run one task together in rounds: Run calls task(m) for every member m at once, the
+// calling thread taking member 0, and returns when all of them are done.  The threads are created once and wait
+// between rounds, so an engine can hand out a round per iteration without paying for thread creation every time.
+class Crew
+{
+private:
+	vector<thread> Threads;
+	mutex Lock;
+	condition_variable Start, Done;
+	function<void(int)> Task;
+	int Round, Pending;
+	bool Stopping;
+	Crew(const Crew&);
+	Crew& operator=(const Crew&);
+
+	// round is the last one run before the thread was created: a Crew created again keeps counting its rounds.
+	void Work(int member, int round)
+	{
+		for (;;)
+		{
+			{
+				unique_lock<mutex> lock(Lock);
+				while (Round == round && !Stopping)
+					Start.wait(lock);
+				if (Stopping)
+					return;
+				round = Round;
+			}
+			Task(member);
+			unique_lock<mutex> lock(Lock);
+			if (--Pending == 0)
+				Done.notify_one();
+		}
+	}
+public:
+	Crew() : Round(0), Pending(0), Stopping(false) {}
+	Crew(int members) : Round(0), Pending(0), Stopping(false) { Create(members); }
+	~Crew() { Delete(); }
+
+	inline void Create(int members)
+	{
+		Delete();
+		Stopping = false;
+		for (int m=1; m<members; ++m)
+			Threads.push_back(thread(&Crew::Work, this, m, Round));
+	}
+
+	inline void Delete()
+	{
+		{
+			unique_lock<mutex> lock(Lock);
+			Stopping = true;
+		}
+		Start.notify_all();
+		for (int m=0; m<(int)Threads.size(); ++m)
+			Threads[m].join();
+		Threads.clear();
+	}
+
+	inline int Size() const { return (int)Threads.size() + 1; }
+
+	void Run(const function<void(int)>& task)
+	{
+		{
+			unique_lock<mutex> lock(Lock);
+			Task = task;
+			Pending = (int)Threads.size();
+			++Round;
+		}
+		Start.notify_all();
+		task(0);
+		unique_lock<mutex> lock(Lock);
+		while (Pending > 0)
+			Done.wait(lock);
+	}
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include "Solution.cpp"
+
+// Cost of every GLS feature of a tracked solution p: the feature of position i is its assignment to p[i], and its
+// cost is i's share of the objective, sum over j of Distance[i][j] * Flow[p[i]][p[j]].  Kept up to date in O(n)
+// per swap instead of being summed again in O(n^2) for every penalty update: swapping r and s only changes the
+// j == r and j == s terms of the other positions, so each of them gets a two term correction and only r and s
+// are summed in full.
+class FeatureCosts
+{
+private:
+	Cost *Values;
+	Solution *Tracked;
+	FeatureCosts(const FeatureCosts&);
+	FeatureCosts& operator=(const FeatureCosts&);
+
+	inline Cost Sum(int i)
+	{
+		Solution &p = *Tracked;
+		const Cost *ai = p.Problem.Distance[i], *fi = p.Problem.Flow[p[i]];
+		Cost sum = 0;
+		for (int j=0; j<p.Size(); ++j)
+			sum += ai[j] * fi[p[j]];
+		return sum;
+	}
+public:
+	FeatureCosts() : Values(NULL), Tracked(NULL) {}
+	~FeatureCosts() { Delete(); }
+
+	inline void Track(Solution& p)
+	{
+		Delete();
+		Tracked = &p;
+		Values = new Cost[p.Size()];
+		Refresh();
+	}
+
+	inline void Delete()
+	{
+		delete [] Values;
+		Values = NULL;
+		Tracked = NULL;
+	}
+
+	// Sums every feature again, after anything other than a reported swap changed the tracked solution.
+	inline void Refresh()
+	{
+		for (int i=0; i<Tracked->Size(); ++i)
+			Values[i] = Sum(i);
+	}
+
+	// Brings the costs up to date after the tracked solution swapped r and s.
+	inline void Moved(int r, int s)
+	{
+		Solution &p = *Tracked;
+		const CostMatrix &a = p.Problem.Distance, &f = p.Problem.Flow;
+		int pr = p[r], ps = p[s];
+		for (int i=0; i<p.Size(); ++i)
+		{
+			const Cost *ai = a[i], *fi = f[p[i]];
+			Values[i] += (ai[r] - ai[s]) * (fi[pr] - fi[ps]);
+		}
+		Values[r] = Sum(r);
+		Values[s] = Sum(s);
+	}
+
+	inline Cost operator[](int i) const { return Values[i]; }
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include "MersenneTwister.cpp"
+#include "Random.cpp"
+#include "Matrix.cpp"
 #include <assert.h>
 #include <fstream>
 #include <time.h>
@@ -10,11 +12,31 @@
 
 using namespace std;
 
+#ifdef _MSC_VER
+#define QAP_THREAD __declspec(thread)
+#define QAP_NOINLINE __declspec(noinline)
+#else
+#define QAP_THREAD __thread
+#define QAP_NOINLINE __attribute__((noinline))
+#endif
+
+// Generator behind Global::Rand and every search's stream; -DQAP_RANDOM=MTRand brings back the Mersenne Twister.
+#ifndef QAP_RANDOM
+#define QAP_RANDOM Xoshiro256
+#endif
+typedef QAP_RANDOM RandomGenerator;
+
 class Global
 {
-	static MTRand Twister;
+	static RandomGenerator Shared;
+	static QAP_THREAD RandomGenerator *Stream; // generator of the calling thread when set, otherwise Shared
+	static inline RandomGenerator& Generator() { return Stream != NULL ? *Stream : Shared; }
+	template<typename G>
+	static inline void Fill(G& generator, double *values, int count) { for (int k=0; k<count; ++k) values[k] = generator.rand(); }
+	static inline void Fill(Xoshiro256& generator, double *values, int count) { generator.Fill(values, count); }
 public:
 	static fstream Log;
+	static unsigned long long Seed; // master seed: Shared and, through Derive, every search's stream follow from it
 
 	static int Max;
 	static int Min;
@@ -22,7 +44,7 @@ public:
 	static bool FileExists(string filename)
 	{
 	  ifstream ifile(filename.c_str());
-	  return ifile;
+	  return ifile.good();
 	}
 
 	// case insensitive string comparison
@@ -68,11 +90,55 @@ public:
 
 
 	// Integer between [0,n-1] -- twister uses inclusive but it makes more sense to make it exclusive.
-	static inline int Rand(int n) { return Twister.randInt(n <= 0 ? 0 : n-1); }
+	static inline int Rand(int n) { return Generator().randInt(n <= 0 ? 0 : n-1); }
 	// Integer between [incLB, excUB)
 	static inline int Rand(int incLB, int excUB) { return incLB + Global::Rand(excUB-incLB);}
-	// Random between [0,1]
-	static inline double Rand() { return Twister.rand(); }
+	// Random between [0,1] ([0,1) with Xoshiro256)
+	static inline double Rand() { return Generator().rand(); }
+	// count draws of Rand() at once, for loops that use one or two per pair.
+	static inline void Rand(double *values, int count) { Fill(Generator(), values, count); }
+	// Snapshot/restore of the generator, so self-checks can draw numbers without shifting a run's random stream.
+	static inline RandomGenerator GetRandomState() { return Generator(); }
+	static inline void SetRandomState(const RandomGenerator& state) { Generator() = state; }
+	// Has the calling thread draw from stream (NULL: the shared generator again), so concurrent searches do not share
+	// one; returns the stream it drew from before.
+	static inline RandomGenerator* UseStream(RandomGenerator *stream) { RandomGenerator *previous = Stream; Stream = stream; return previous; }
+
+	// Seed of stream index in the family of streams under seed: the SplitMix64 output index+1 steps after seed.  A
+	// stream depends only on the master seed and on where it sits in the experiment, never on which thread runs it
+	// or when, so a run repeats bit for bit whatever the number of threads.
+	static inline unsigned long long Derive(unsigned long long seed, unsigned long long index)
+	{
+		unsigned long long z = seed + (index+1) * 0x9E3779B97F4A7C15ULL;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+	static inline void SeedStream(MTRand& stream, unsigned long long seed)
+	{
+		MTRand::uint32 key[2] = { MTRand::uint32(seed & 0xFFFFFFFFUL), MTRand::uint32(seed >> 32) };
+		stream.seed(key, 2);
+	}
+	static inline void SeedStream(Xoshiro256& stream, unsigned long long seed) { stream.Seed(seed); }
+	// Seed for a new family of streams, drawn from the calling thread's generator.
+	static inline unsigned long long NewSeed()
+	{
+		RandomGenerator &g = Generator();
+		unsigned long long high = g.randInt();
+		return high << 32 | g.randInt();
+	}
+	// Master seed from the clock and /dev/urandom, for runs that need not repeat.
+	static inline unsigned long long FreshSeed()
+	{
+		MTRand fresh;
+		unsigned long long high = fresh.randInt();
+		return high << 32 | fresh.randInt();
+	}
+	static inline void Reseed(unsigned long long seed)
+	{
+		Seed = seed;
+		SeedStream(Shared, seed);
+	}
 	// Random double betwen [incMin, incMax]
 	static inline double RandDouble(double incMin, double incMax)
 	{
@@ -84,55 +150,58 @@ public:
 		assert(minValue <= maxValue);
 		return value = max(minValue, min(value, maxValue));
 	}
+	// Matrix helpers below take either a BasicMatrix or a TriangularMatrix.  A TriangularMatrix only has the
+	// upper triangle, so it must be scanned with symmetric=true.
+
 	// m <-- n
-	static inline void CopyMatrix(double** m, double **n, int rows)
+	template<typename M>
+	static inline void CopyMatrix(M& m, const M& n)
 	{
-		for (int i=0; i<rows; ++i)
-			for (int j=0; j<rows; ++j)
-				m[i][j] = n[i][j];
+		assert(m.Size == n.Size && m.Count() == n.Count());
+		memcpy(m.Data(), n.Data(), n.Count() * sizeof(typename M::Element));
 	}
 
-	static inline void DeleteMatrix(double**& m, int rows)
+	template<typename M>
+	static inline void DeleteMatrix(M& m)
 	{
-		if (m == NULL) return;
-		for (int i=0; i<rows; ++i)
-			delete[] m[i];
-		delete [] m;
+		m.Delete();
 	}
-	static inline double** CreateMatrix(int n, double initialValue=Global::Max)
+	template<typename M>
+	static inline void CreateMatrix(M& m, int n, double initialValue=Global::Max)
 	{
-		double** m = new double*[n];
-		for (int i=0; i<n; ++i)
-		{
-			m[i] = new double[n];
-			if (initialValue != Global::Max)
-				for (int j=0;j<n; ++j)
-					m[i][j] = initialValue;
-		}
-
-		return m;
+		m.Create(n);
+		if (initialValue != Global::Max && initialValue != 0) // Create zero fills
+			m.Fill((typename M::Element)initialValue);
 	}
 
-	static inline void FindMin(double **m, int rows, bool symmetric, int &iBest, int &jBest)
+	template<typename M>
+	static inline void FindMin(M& m, bool symmetric, int &iBest, int &jBest)
 	{
-		double best = Global::Max;
+		typedef typename M::Element T;
+		assert(symmetric || !M::UpperOnly);
+		T best = Global::Max;
+		int rows = m.Size;
 		for (int i=0; i<rows; ++i)
+		{
+			T *row = m[i];
 			for (int j=(symmetric?i:0); j<rows; ++j)
 			{
-				if (m[i][j] < best)
+				if (row[j] < best)
 				{
 					iBest = i;
 					jBest = j;
-					best = m[i][j];
+					best = row[j];
 				}
 			}
+		}
 	}
 
-	static inline void PrintMatrix(double** m, int rows)
+	template<typename M>
+	static inline void PrintMatrix(M& m)
 	{
-		for (int i=0; i<rows; ++i)
+		for (int i=0; i<m.Size; ++i)
 		{
-			for (int j=i+1; j<rows; ++j)
+			for (int j=i+1; j<m.Size; ++j)
 				cout << m[i][j] << " ";
 			cout << endl;
 		}
@@ -140,8 +209,11 @@ public:
 
 	// Round roulette proportionality selection using inverted weights and normalizing all weights between [1,infinity first). 
 	// Those that have lowest value get highest weight. 
-	static inline void InverseRoulette(double** m, int n, bool symmetric, double best, double power, int *choiceI, int *choiceJ)
+	template<typename M>
+	static inline void InverseRoulette(M& m, bool symmetric, double best, double power, int *choiceI, int *choiceJ)
 	{
+		assert(symmetric || !M::UpperOnly);
+		int n = m.Size;
 		double sum = 0;
 		double minNum = Global::Max, maxNum = Global::Min;
 		int count = 0, minI, minJ;
@@ -154,7 +226,7 @@ public:
 				{
 					minNum = m[i][j]; minI = i; minJ = j;
 				}
-				maxNum = max(maxNum, m[i][j]);
+				maxNum = max(maxNum, (double)m[i][j]);
 			}
 
 		// do roulette only if we couldn't find a better best solution!
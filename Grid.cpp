@@ -4,6 +4,7 @@
 #include <fstream>
 #include <iomanip>
 #include <string>
+#include <mutex>
 
 #include "Algorithm.cpp"
 #include "Global.cpp"
@@ -27,8 +28,11 @@ private:
 	Statistics* TotalDeviation;
 	Statistics* TotalBestDeviation;
 	Statistics* TotalBestCount;
+	vector<Result*> Cells; // completed cells not printed yet, numbered row by row
+	int Printed; // cells printed so far
+	mutex Lock;
 public:
-	Grid(string fileName, string description, int runs, int runTime, int iterations, vector<Algorithm*>& algos) : Algos(algos), CurrentProblem(NULL), Cols(0), Runs(runs), Runtime(runTime), Iterations(iterations), Description(description) 
+	Grid(string fileName, string description, int runs, int runTime, int iterations, vector<Algorithm*>& algos) : Algos(algos), CurrentProblem(NULL), Cols(0), Runs(runs), Runtime(runTime), Iterations(iterations), Description(description), Printed(0) 
 	{
 		Global::OpenFile(fileName, Log);
 		assert(algos.size() > 0);
@@ -40,7 +44,7 @@ public:
 	void PrintHeader()
 	{
 		Log << Description << endl << endl;
-		Log << "RUNS = " << Runs << "   RUNTIME = " << Runtime << "s   ITERATIONS = " << Iterations <<  endl;
+		Log << "RUNS = " << Runs << "   RUNTIME = " << Runtime << "s   ITERATIONS = " << Iterations << "   SEED = " << Global::Seed << endl;
 		Log << endl;
 		Log << "PARAMETERS" << endl;
 		for (int i=0; i<Algos.size(); ++i)
@@ -85,6 +89,22 @@ public:
 		Log.flush();
 	}
 
+	// Takes result, which the grid deletes, for cell number cell counting row by row, and prints every cell up to the
+	// first one still missing, so cells run concurrently and finishing in any order still print in grid order.
+	void Add(int cell, Result* result)
+	{
+		unique_lock<mutex> lock(Lock);
+		if (cell >= (int)Cells.size())
+			Cells.resize(cell+1, NULL);
+		Cells[cell] = result;
+		for (; Printed < (int)Cells.size() && Cells[Printed] != NULL; ++Printed)
+		{
+			Print(*Cells[Printed]);
+			delete Cells[Printed];
+			Cells[Printed] = NULL;
+		}
+	}
+
 	void NewLine(int count=1) { for (int i=0;i<count; ++i) Log << endl; Log.flush(); }
 	void PrintFooter()
 	{
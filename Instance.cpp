@@ -6,13 +6,109 @@
 #include <assert.h>
 #include <sstream>
 #include <cstdlib>
+#include <limits>
+#include <math.h>
+#include "Matrix.cpp"
+#include "Global.cpp"
 using namespace std;
 
+// Type of the flow/distance data, fitness values and swap costs.  All QAPLIB instances are integral so an exact
+// integer build can be selected at compile time with -DQAP_COST=int (or -DQAP_COST="long long" for wide tai-b instances).
+#ifndef QAP_COST
+#define QAP_COST double
+#endif
+typedef QAP_COST Cost;
+typedef BasicMatrix<Cost> CostMatrix;
+typedef TriangularMatrix<Cost> DeltaMatrix; // swap costs, (i,j) with i < j
+
+// Largest fraction of nonzero entries for which a matrix gets a sparse view (see Instance::DetectSparsity).  The dense
+// kernels are vectorized and the sparse ones gather, so the break-even density is low: tai64c (4%) gains, tai256c (13%) does not.
+#ifndef QAP_SPARSE_DENSITY
+#define QAP_SPARSE_DENSITY 0.05
+#endif
+
+// Which matrix, if any, the cost kernels read through Instance::SparseRows/SparseColumns.
+enum SparseMode { NoSparse, DistanceSparse, FlowSparse };
+
 class Instance
 {
 private:
+	// Bound on |fitness| and |swap cost| for this instance, so an integer cost type can be checked before any search runs.
+	inline void ValidateCostRange()
+	{
+		double sumFlow = 0, sumDistance = 0, maxFlow = 0, maxDistance = 0;
+		for (int i=0; i<Size; ++i)
+			for (int j=0; j<Size; ++j)
+			{
+				sumFlow += fabs((double)Flow[i][j]);
+				sumDistance += fabs((double)Distance[i][j]);
+				maxFlow = max(maxFlow, fabs((double)Flow[i][j]));
+				maxDistance = max(maxDistance, fabs((double)Distance[i][j]));
+			}
+		double bound = 4 * min(sumFlow * maxDistance, sumDistance * maxFlow); // swap cost partial sums stay within 4x any fitness value
+		if (numeric_limits<Cost>::is_integer && bound > (double)numeric_limits<Cost>::max())
+		{
+			cerr << "Instance " << InstanceName << " may overflow the " << sizeof(Cost)*8 << "-bit cost type (bound=" << bound << "). Rebuild with a wider QAP_COST." << endl;
+			exit(1);
+		}
+	}
+
+	// Shape flags that let Solution pick a simpler swap cost formula for the whole run.
+	inline void DetectShape()
+	{
+		Symmetric = ZeroDiagonal = true;
+		for (int i=0; i<Size; ++i)
+		{
+			if (Flow[i][i] != 0 || Distance[i][i] != 0)
+				ZeroDiagonal = false;
+			for (int j=i+1; j<Size; ++j)
+				if (Flow[i][j] != Flow[j][i] || Distance[i][j] != Distance[j][i])
+					Symmetric = false;
+		}
+	}
+
+	// Real-life instances (esc, tai-c, ste, kra, ...) have one matrix that is mostly zeros.  The sparser of the two
+	// gets compressed row and column views when its density is at most QAP_SPARSE_DENSITY.
+	inline void DetectSparsity()
+	{
+		int flow = 0, distance = 0;
+		for (int i=0; i<Size; ++i)
+			for (int j=0; j<Size; ++j)
+			{
+				if (Flow[i][j] != 0) ++flow;
+				if (Distance[i][j] != 0) ++distance;
+			}
+		int nonZeros = min(flow, distance);
+		Sparse = nonZeros > QAP_SPARSE_DENSITY * Size * Size ? NoSparse : distance <= flow ? DistanceSparse : FlowSparse;
+		if (Sparse == NoSparse)
+			return;
+		const CostMatrix &m = Sparse == DistanceSparse ? Distance : Flow;
+		SparseRows.Create(m);
+		SparseColumns.Create(m, true);
+	}
+	// Everything derived from Flow and Distance once they are filled in.
+	inline void Prepare()
+	{
+		ValidateCostRange();
+		DetectShape();
+		DetectSparsity();
+		Width = Flow.Stride <= 64 ? Flow.Stride : 0;
+		if (!Symmetric)
+		{
+			DistanceT.Create(Size);
+			for (int i=0; i<Size; ++i)
+				for (int j=0; j<Size; ++j)
+					DistanceT[j][i] = Distance[i][j];
+		}
+	}
 public: 
-	double **Flow, **Distance;
+	CostMatrix Flow, Distance;
+	CostMatrix DistanceT; // Distance transposed, so the swap cost kernels can stream its columns as rows (asymmetric instances only)
+	bool Symmetric;    // Flow and Distance are both symmetric
+	bool ZeroDiagonal; // Flow and Distance both have an all-zero diagonal
+	SparseMode Sparse; // matrix held in SparseRows/SparseColumns, NoSparse when both are dense
+	SparseMatrix<Cost> SparseRows, SparseColumns; // compressed rows and columns of the sparse matrix
+	int Width;         // padded row width of the matrices, which the cost kernels are compiled for up to 64; 0 above that
 	int Size;
 	string InstanceName, OptimalAlgorithm;
 	double OptimalFitness;
@@ -33,31 +129,48 @@ public:
 			}
 		}
 		in >> Size;
-		Flow = new double*[Size];
-		Distance = new double*[Size];
+		Flow.Create(Size);
+		Distance.Create(Size);
+		double value;
 		for (int k=0; k<2; ++k)
 		{
-			double **x = k==0 ? Flow : Distance;
+			CostMatrix &x = k==0 ? Flow : Distance;
 			for (int i=0; i<Size; ++i)
-			{
-				x[i] = new double[Size];
 				for (int j=0; j<Size; ++j)
-					in >> x[i][j];
-			}
+				{
+					in >> value;
+					x[i][j] = (Cost)value;
+					if ((double)x[i][j] != value)
+					{
+						cerr << "Instance " << instanceName << " has a value the cost type cannot hold exactly: " << value << endl;
+						exit(1);
+					}
+				}
 		}
+		Prepare();
 		SetVars();
 		in.close();
 	}
 
-	~Instance()
+	// Random symmetric instance of size n in the style of Taillard's tai-a ones (flows and distances uniform in 0..99,
+	// zero diagonal), for measuring throughput at sizes QAPLIB does not have.  Draws from the global generator.
+	Instance(int n)
 	{
+		stringstream name;
+		name << "rand" << n;
+		InstanceName = name.str();
+		Size = n;
+		Flow.Create(Size);
+		Distance.Create(Size);
 		for (int i=0; i<Size; ++i)
-		{
-			delete [] Flow[i];
-			delete [] Distance[i];
-		}
-		delete [] Flow;
-		delete [] Distance;
+			for (int j=i+1; j<Size; ++j)
+			{
+				Flow[i][j] = Flow[j][i] = (Cost)Global::Rand(100);
+				Distance[i][j] = Distance[j][i] = (Cost)Global::Rand(100);
+			}
+		Prepare();
+		OptimalFitness = 0;
+		Type = "[I]";
 	}
 
 	string ToString() 
@@ -0,0 +1,505 @@
+#pragma once
+#include <cstddef>
+
+using namespace std;
+
+// Vectorized inner loops of the swap cost evaluation.  Each kernel has a scalar version plus AVX2 and AVX-512
+// versions for double and int costs; the widest one supported by the CPU is picked at startup.  Other cost types
+// (long long) always use the scalar loop, which the compiler is free to auto-vectorize.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define QAP_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(QAP_X86) && (defined(__GNUC__) || defined(_MSC_VER) && _MSC_VER >= 1911) // VS2012 has no AVX-512 intrinsics
+#define QAP_AVX512
+#endif
+
+#if defined(__GNUC__)
+#define QAP_TARGET_AVX2 __attribute__((target("avx2")))
+#define QAP_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define QAP_TARGET_AVX2
+#define QAP_TARGET_AVX512
+#endif
+
+enum KernelLevel { ScalarKernels, Avx2Kernels, Avx512Kernels };
+
+class Kernels
+{
+public:
+	// Widest instruction set supported by both the CPU and the OS.
+	static inline KernelLevel Detect()
+	{
+#if defined(QAP_X86) && defined(__GNUC__)
+		__builtin_cpu_init();
+#ifdef QAP_AVX512
+		if (__builtin_cpu_supports("avx512f")) return Avx512Kernels;
+#endif
+		if (__builtin_cpu_supports("avx2")) return Avx2Kernels;
+#elif defined(QAP_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return ScalarKernels;
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1<<27)) != 0, avx = (info[2] & (1<<28)) != 0;
+		if (!osxsave || !avx) return ScalarKernels;
+		unsigned long long xcr0 = _xgetbv(0);
+		if ((xcr0 & 0x6) != 0x6) return ScalarKernels; // OS does not save ymm state
+		__cpuidex(info, 7, 0);
+#ifdef QAP_AVX512
+		if ((info[1] & (1<<16)) && (xcr0 & 0xe6) == 0xe6) return Avx512Kernels;
+#endif
+		if (info[1] & (1<<5)) return Avx2Kernels;
+#endif
+		return ScalarKernels;
+	}
+
+	// Kernel set in use.  Detected on first use; may be lowered (never raised above Detect()) to compare implementations.
+	static inline KernelLevel& Level()
+	{
+		static KernelLevel level = Detect();
+		return level;
+	}
+
+	// sum over k in [0,n) of (a1[k]-a2[k]) * (b1[k]-b2[k])
+	template<typename T>
+	static inline T Dot(const T *a1, const T *a2, const T *b1, const T *b2, int n)
+	{
+		switch (Level())
+		{
+#ifdef QAP_AVX512
+			case Avx512Kernels: return DotAvx512(a1, a2, b1, b2, n);
+#endif
+#ifdef QAP_X86
+			case Avx2Kernels: return DotAvx2(a1, a2, b1, b2, n);
+#endif
+			default: return DotScalar(a1, a2, b1, b2, n);
+		}
+	}
+
+	// Dot over exactly Width elements of 64-byte aligned rows, for instances whose matrix rows are padded to Width
+	// (see Instance::Width).  The trip count is a compile-time constant, so the loop has no tail and is fully unrolled.
+	template<int Width, typename T>
+	static inline T DotFixed(const T *a1, const T *a2, const T *b1, const T *b2)
+	{
+		switch (Level())
+		{
+#ifdef QAP_AVX512
+			case Avx512Kernels: return DotFixedAvx512<Width>(a1, a2, b1, b2);
+#endif
+#ifdef QAP_X86
+			case Avx2Kernels: return DotFixedAvx2<Width>(a1, a2, b1, b2);
+#endif
+			default: return DotScalar(a1, a2, b1, b2, Width);
+		}
+	}
+
+	// row[v] += (xu-x[v])*(yu-y[v]) + (pu-p[v])*(qu-q[v])  for v in [from,to).  Taillard's update of one delta row.
+	// Symmetric instances have p == x and q == y, so the second product is the first one again and p, q are not read.
+	template<bool Symmetric, typename T>
+	static inline void UpdateRow(T *row, const T *x, const T *y, const T *p, const T *q, T xu, T yu, T pu, T qu, int from, int to)
+	{
+		switch (Level())
+		{
+#ifdef QAP_AVX512
+			case Avx512Kernels: UpdateRowAvx512<Symmetric>(row, x, y, p, q, xu, yu, pu, qu, from, to); return;
+#endif
+#ifdef QAP_X86
+			case Avx2Kernels: UpdateRowAvx2<Symmetric>(row, x, y, p, q, xu, yu, pu, qu, from, to); return;
+#endif
+			default: UpdateRowScalar<Symmetric>(row, x, y, p, q, xu, yu, pu, qu, from, to);
+		}
+	}
+
+	// UpdateRow over four consecutive rows of strided matrices at once: x, y, p, q point to the first row of each
+	// block, with entries xu[j], yu[j], pu[j], qu[j] for row j.  Each row[v] is loaded and stored once per block
+	// instead of once per row.  Always runs v over [0,n).
+	template<bool Symmetric, typename T>
+	static inline void UpdateRowBlock(T *row, const T *x, const T *y, const T *p, const T *q, int stride, const T *xu, const T *yu, const T *pu, const T *qu, int n)
+	{
+		switch (Level())
+		{
+#ifdef QAP_AVX512
+			case Avx512Kernels: UpdateRowBlockAvx512<Symmetric>(row, x, y, p, q, stride, xu, yu, pu, qu, n); return;
+#endif
+#ifdef QAP_X86
+			case Avx2Kernels: UpdateRowBlockAvx2<Symmetric>(row, x, y, p, q, stride, xu, yu, pu, qu, n); return;
+#endif
+			default: UpdateRowBlockScalar<Symmetric>(row, x, y, p, q, stride, xu, yu, pu, qu, 0, n);
+		}
+	}
+
+	static const int RowBlock = 4;
+
+	// - - - - - - - - - - - - - - - Scalar - - - - - - - - - - - - - - - - -
+
+	template<typename T>
+	static inline T DotScalar(const T *a1, const T *a2, const T *b1, const T *b2, int n)
+	{
+		T sum = 0;
+		for (int k=0; k<n; ++k)
+			sum += (a1[k]-a2[k]) * (b1[k]-b2[k]);
+		return sum;
+	}
+
+	template<bool Symmetric, typename T>
+	static inline void UpdateRowScalar(T *row, const T *x, const T *y, const T *p, const T *q, T xu, T yu, T pu, T qu, int from, int to)
+	{
+		if (Symmetric)
+		{
+			for (int v=from; v<to; ++v)
+			{
+				T t = (xu-x[v])*(yu-y[v]);
+				row[v] += t + t;
+			}
+			return;
+		}
+		for (int v=from; v<to; ++v)
+			row[v] += (xu-x[v])*(yu-y[v]) + (pu-p[v])*(qu-q[v]);
+	}
+
+	template<bool Symmetric, typename T>
+	static inline void UpdateRowBlockScalar(T *row, const T *x, const T *y, const T *p, const T *q, int stride, const T *xu, const T *yu, const T *pu, const T *qu, int from, int to)
+	{
+		for (int j=0; j<RowBlock; ++j)
+			UpdateRowScalar<Symmetric>(row, x + j*stride, y + j*stride, p + j*stride, q + j*stride, xu[j], yu[j], pu[j], qu[j], from, to);
+	}
+
+	// Cost types without a vector version fall back to the scalar loop.
+	template<typename T>
+	static inline T DotAvx2(const T *a1, const T *a2, const T *b1, const T *b2, int n) { return DotScalar(a1, a2, b1, b2, n); }
+	template<typename T>
+	static inline T DotAvx512(const T *a1, const T *a2, const T *b1, const T *b2, int n) { return DotScalar(a1, a2, b1, b2, n); }
+	template<int Width, typename T>
+	static inline T DotFixedAvx2(const T *a1, const T *a2, const T *b1, const T *b2) { return DotScalar(a1, a2, b1, b2, Width); }
+	template<int Width, typename T>
+	static inline T DotFixedAvx512(const T *a1, const T *a2, const T *b1, const T *b2) { return DotScalar(a1, a2, b1, b2, Width); }
+	template<bool Symmetric, typename T>
+	static inline void UpdateRowAvx2(T *row, const T *x, const T *y, const T *p, const T *q, T xu, T yu, T pu, T qu, int from, int to) { UpdateRowScalar<Symmetric>(row, x, y, p, q, xu, yu, pu, qu, from, to); }
+	template<bool Symmetric, typename T>
+	static inline void UpdateRowAvx512(T *row, const T *x, const T *y, const T *p, const T *q, T xu, T yu, T pu, T qu, int from, int to) { UpdateRowScalar<Symmetric>(row, x, y, p, q, xu, yu, pu, qu, from, to); }
+	template<bool Symmetric, typename T>
+	static inline void UpdateRowBlockAvx2(T *row, const T *x, const T *y, const T *p, const T *q, int stride, const T *xu, const T *yu, const T *pu, const T *qu, int n) { UpdateRowBlockScalar<Symmetric>(row, x, y, p, q, stride, xu, yu, pu, qu, 0, n); }
+	template<bool Symmetric, typename T>
+	static inline void UpdateRowBlockAvx512(T *row, const T *x, const T *y, const T *p, const T *q, int stride, const T *xu, const T *yu, const T *pu, const T *qu, int n) { UpdateRowBlockScalar<Symmetric>(row, x, y, p, q, stride, xu, yu, pu, qu, 0, n); }
+
+#ifdef QAP_X86
+	// - - - - - - - - - - - - - - - AVX2 - - - - - - - - - - - - - - - - -
+
+	QAP_TARGET_AVX2 static double DotAvx2(const double *a1, const double *a2, const double *b1, const double *b2, int n)
+	{
+		__m256d sum = _mm256_setzero_pd();
+		int k = 0;
+		for (; k+4<=n; k+=4)
+		{
+			__m256d a = _mm256_sub_pd(_mm256_loadu_pd(a1+k), _mm256_loadu_pd(a2+k));
+			__m256d b = _mm256_sub_pd(_mm256_loadu_pd(b1+k), _mm256_loadu_pd(b2+k));
+			sum = _mm256_add_pd(sum, _mm256_mul_pd(a, b));
+		}
+		double lane[4];
+		_mm256_storeu_pd(lane, sum);
+		double total = (lane[0]+lane[1]) + (lane[2]+lane[3]);
+		for (; k<n; ++k)
+			total += (a1[k]-a2[k]) * (b1[k]-b2[k]);
+		return total;
+	}
+
+	QAP_TARGET_AVX2 static int DotAvx2(const int *a1, const int *a2, const int *b1, const int *b2, int n)
+	{
+		__m256i sum = _mm256_setzero_si256();
+		int k = 0;
+		for (; k+8<=n; k+=8)
+		{
+			__m256i a = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(a1+k)), _mm256_loadu_si256((const __m256i*)(a2+k)));
+			__m256i b = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(b1+k)), _mm256_loadu_si256((const __m256i*)(b2+k)));
+			sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(a, b));
+		}
+		int lane[8];
+		_mm256_storeu_si256((__m256i*)lane, sum);
+		int total = 0;
+		for (int i=0; i<8; ++i)
+			total += lane[i];
+		for (; k<n; ++k)
+			total += (a1[k]-a2[k]) * (b1[k]-b2[k]);
+		return total;
+	}
+
+	// Two accumulators, so consecutive iterations do not wait on each other's add.
+	template<int Width>
+	QAP_TARGET_AVX2 static double DotFixedAvx2(const double *a1, const double *a2, const double *b1, const double *b2)
+	{
+		__m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+		for (int k=0; k<Width; k+=8)
+		{
+			sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(a1+k), _mm256_load_pd(a2+k)), _mm256_sub_pd(_mm256_load_pd(b1+k), _mm256_load_pd(b2+k))));
+			sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(a1+k+4), _mm256_load_pd(a2+k+4)), _mm256_sub_pd(_mm256_load_pd(b1+k+4), _mm256_load_pd(b2+k+4))));
+		}
+		__m256d sum = _mm256_add_pd(sum0, sum1);
+		__m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+	}
+
+	template<int Width>
+	QAP_TARGET_AVX2 static int DotFixedAvx2(const int *a1, const int *a2, const int *b1, const int *b2)
+	{
+		__m256i sum = _mm256_setzero_si256();
+		for (int k=0; k<Width; k+=8)
+		{
+			__m256i a = _mm256_sub_epi32(_mm256_load_si256((const __m256i*)(a1+k)), _mm256_load_si256((const __m256i*)(a2+k)));
+			__m256i b = _mm256_sub_epi32(_mm256_load_si256((const __m256i*)(b1+k)), _mm256_load_si256((const __m256i*)(b2+k)));
+			sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(a, b));
+		}
+		__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+		return _mm_cvtsi128_si32(half);
+	}
+
+	template<bool Symmetric>
+	QAP_TARGET_AVX2 static void UpdateRowAvx2(double *row, const double *x, const double *y, const double *p, const double *q, double xu, double yu, double pu, double qu, int from, int to)
+	{
+		__m256d vx = _mm256_set1_pd(xu), vy = _mm256_set1_pd(yu), vp = _mm256_set1_pd(pu), vq = _mm256_set1_pd(qu);
+		int v = from;
+		for (; v+4<=to; v+=4)
+		{
+			__m256d t1 = _mm256_mul_pd(_mm256_sub_pd(vx, _mm256_loadu_pd(x+v)), _mm256_sub_pd(vy, _mm256_loadu_pd(y+v)));
+			__m256d t2 = Symmetric ? t1 : _mm256_mul_pd(_mm256_sub_pd(vp, _mm256_loadu_pd(p+v)), _mm256_sub_pd(vq, _mm256_loadu_pd(q+v)));
+			_mm256_storeu_pd(row+v, _mm256_add_pd(_mm256_loadu_pd(row+v), _mm256_add_pd(t1, t2)));
+		}
+		UpdateRowScalar<Symmetric>(row, x, y, p, q, xu, yu, pu, qu, v, to);
+	}
+
+	template<bool Symmetric>
+	QAP_TARGET_AVX2 static void UpdateRowAvx2(int *row, const int *x, const int *y, const int *p, const int *q, int xu, int yu, int pu, int qu, int from, int to)
+	{
+		__m256i vx = _mm256_set1_epi32(xu), vy = _mm256_set1_epi32(yu), vp = _mm256_set1_epi32(pu), vq = _mm256_set1_epi32(qu);
+		int v = from;
+		for (; v+8<=to; v+=8)
+		{
+			__m256i t1 = _mm256_mullo_epi32(_mm256_sub_epi32(vx, _mm256_loadu_si256((const __m256i*)(x+v))), _mm256_sub_epi32(vy, _mm256_loadu_si256((const __m256i*)(y+v))));
+			__m256i t2 = Symmetric ? t1 : _mm256_mullo_epi32(_mm256_sub_epi32(vp, _mm256_loadu_si256((const __m256i*)(p+v))), _mm256_sub_epi32(vq, _mm256_loadu_si256((const __m256i*)(q+v))));
+			__m256i r = _mm256_loadu_si256((const __m256i*)(row+v));
+			_mm256_storeu_si256((__m256i*)(row+v), _mm256_add_epi32(r, _mm256_add_epi32(t1, t2)));
+		}
+		UpdateRowScalar<Symmetric>(row, x, y, p, q, xu, yu, pu, qu, v, to);
+	}
+
+	template<bool Symmetric>
+	QAP_TARGET_AVX2 static void UpdateRowBlockAvx2(double *row, const double *x, const double *y, const double *p, const double *q, int stride, const double *xu, const double *yu, const double *pu, const double *qu, int n)
+	{
+		__m256d vx[RowBlock], vy[RowBlock], vp[RowBlock], vq[RowBlock];
+		for (int j=0; j<RowBlock; ++j)
+		{
+			vx[j] = _mm256_set1_pd(xu[j]); vy[j] = _mm256_set1_pd(yu[j]);
+			vp[j] = _mm256_set1_pd(pu[j]); vq[j] = _mm256_set1_pd(qu[j]);
+		}
+		int v = 0;
+		for (; v+4<=n; v+=4)
+		{
+			__m256d sum = _mm256_setzero_pd();
+			for (int j=0; j<RowBlock; ++j)
+			{
+				int k = j*stride + v;
+				sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_sub_pd(vx[j], _mm256_loadu_pd(x+k)), _mm256_sub_pd(vy[j], _mm256_loadu_pd(y+k))));
+				if (!Symmetric)
+					sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_sub_pd(vp[j], _mm256_loadu_pd(p+k)), _mm256_sub_pd(vq[j], _mm256_loadu_pd(q+k))));
+			}
+			if (Symmetric)
+				sum = _mm256_add_pd(sum, sum);
+			_mm256_storeu_pd(row+v, _mm256_add_pd(_mm256_loadu_pd(row+v), sum));
+		}
+		UpdateRowBlockScalar<Symmetric>(row, x, y, p, q, stride, xu, yu, pu, qu, v, n);
+	}
+
+	template<bool Symmetric>
+	QAP_TARGET_AVX2 static void UpdateRowBlockAvx2(int *row, const int *x, const int *y, const int *p, const int *q, int stride, const int *xu, const int *yu, const int *pu, const int *qu, int n)
+	{
+		__m256i vx[RowBlock], vy[RowBlock], vp[RowBlock], vq[RowBlock];
+		for (int j=0; j<RowBlock; ++j)
+		{
+			vx[j] = _mm256_set1_epi32(xu[j]); vy[j] = _mm256_set1_epi32(yu[j]);
+			vp[j] = _mm256_set1_epi32(pu[j]); vq[j] = _mm256_set1_epi32(qu[j]);
+		}
+		int v = 0;
+		for (; v+8<=n; v+=8)
+		{
+			__m256i sum = _mm256_setzero_si256();
+			for (int j=0; j<RowBlock; ++j)
+			{
+				int k = j*stride + v;
+				sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_sub_epi32(vx[j], _mm256_loadu_si256((const __m256i*)(x+k))), _mm256_sub_epi32(vy[j], _mm256_loadu_si256((const __m256i*)(y+k)))));
+				if (!Symmetric)
+					sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_sub_epi32(vp[j], _mm256_loadu_si256((const __m256i*)(p+k))), _mm256_sub_epi32(vq[j], _mm256_loadu_si256((const __m256i*)(q+k)))));
+			}
+			if (Symmetric)
+				sum = _mm256_add_epi32(sum, sum);
+			__m256i r = _mm256_loadu_si256((const __m256i*)(row+v));
+			_mm256_storeu_si256((__m256i*)(row+v), _mm256_add_epi32(r, sum));
+		}
+		UpdateRowBlockScalar<Symmetric>(row, x, y, p, q, stride, xu, yu, pu, qu, v, n);
+	}
+#endif
+
+#ifdef QAP_AVX512
+	// - - - - - - - - - - - - - - - AVX-512 - - - - - - - - - - - - - - - - -
+
+	// Sum of the lanes, added in the same order as _mm512_reduce_add_pd, whose upper half extract starts from an
+	// undefined register and trips -Wmaybe-uninitialized.
+	QAP_TARGET_AVX512 static inline double Total(__m512d sum)
+	{
+		double lane[8];
+		_mm512_storeu_pd(lane, sum);
+		double low = (lane[0] + lane[4]) + (lane[2] + lane[6]), high = (lane[1] + lane[5]) + (lane[3] + lane[7]);
+		return low + high;
+	}
+
+	QAP_TARGET_AVX512 static double DotAvx512(const double *a1, const double *a2, const double *b1, const double *b2, int n)
+	{
+		__m512d sum = _mm512_setzero_pd();
+		int k = 0;
+		for (; k+8<=n; k+=8)
+		{
+			__m512d a = _mm512_sub_pd(_mm512_loadu_pd(a1+k), _mm512_loadu_pd(a2+k));
+			__m512d b = _mm512_sub_pd(_mm512_loadu_pd(b1+k), _mm512_loadu_pd(b2+k));
+			sum = _mm512_add_pd(sum, _mm512_mul_pd(a, b));
+		}
+		double total = Total(sum);
+		for (; k<n; ++k)
+			total += (a1[k]-a2[k]) * (b1[k]-b2[k]);
+		return total;
+	}
+
+	QAP_TARGET_AVX512 static int DotAvx512(const int *a1, const int *a2, const int *b1, const int *b2, int n)
+	{
+		__m512i sum = _mm512_setzero_si512();
+		int k = 0;
+		for (; k+16<=n; k+=16)
+		{
+			__m512i a = _mm512_sub_epi32(_mm512_loadu_si512(a1+k), _mm512_loadu_si512(a2+k));
+			__m512i b = _mm512_sub_epi32(_mm512_loadu_si512(b1+k), _mm512_loadu_si512(b2+k));
+			sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(a, b));
+		}
+		int total = _mm512_reduce_add_epi32(sum);
+		for (; k<n; ++k)
+			total += (a1[k]-a2[k]) * (b1[k]-b2[k]);
+		return total;
+	}
+
+	template<int Width>
+	QAP_TARGET_AVX512 static double DotFixedAvx512(const double *a1, const double *a2, const double *b1, const double *b2)
+	{
+		__m512d sum = _mm512_setzero_pd();
+		for (int k=0; k<Width; k+=8)
+		{
+			__m512d a = _mm512_sub_pd(_mm512_load_pd(a1+k), _mm512_load_pd(a2+k));
+			__m512d b = _mm512_sub_pd(_mm512_load_pd(b1+k), _mm512_load_pd(b2+k));
+			sum = _mm512_add_pd(sum, _mm512_mul_pd(a, b));
+		}
+		return Total(sum);
+	}
+
+	template<int Width>
+	QAP_TARGET_AVX512 static int DotFixedAvx512(const int *a1, const int *a2, const int *b1, const int *b2)
+	{
+		__m512i sum = _mm512_setzero_si512();
+		int k = 0;
+		for (; k+16<=Width; k+=16)
+		{
+			__m512i a = _mm512_sub_epi32(_mm512_load_si512(a1+k), _mm512_load_si512(a2+k));
+			__m512i b = _mm512_sub_epi32(_mm512_load_si512(b1+k), _mm512_load_si512(b2+k));
+			sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(a, b));
+		}
+		int total = _mm512_reduce_add_epi32(sum);
+		for (; k<Width; ++k) // int rows are padded to 16, so only widths that are never used get here
+			total += (a1[k]-a2[k]) * (b1[k]-b2[k]);
+		return total;
+	}
+
+	template<bool Symmetric>
+	QAP_TARGET_AVX512 static void UpdateRowAvx512(double *row, const double *x, const double *y, const double *p, const double *q, double xu, double yu, double pu, double qu, int from, int to)
+	{
+		__m512d vx = _mm512_set1_pd(xu), vy = _mm512_set1_pd(yu), vp = _mm512_set1_pd(pu), vq = _mm512_set1_pd(qu);
+		int v = from;
+		for (; v+8<=to; v+=8)
+		{
+			__m512d t1 = _mm512_mul_pd(_mm512_sub_pd(vx, _mm512_loadu_pd(x+v)), _mm512_sub_pd(vy, _mm512_loadu_pd(y+v)));
+			__m512d t2 = Symmetric ? t1 : _mm512_mul_pd(_mm512_sub_pd(vp, _mm512_loadu_pd(p+v)), _mm512_sub_pd(vq, _mm512_loadu_pd(q+v)));
+			_mm512_storeu_pd(row+v, _mm512_add_pd(_mm512_loadu_pd(row+v), _mm512_add_pd(t1, t2)));
+		}
+		UpdateRowScalar<Symmetric>(row, x, y, p, q, xu, yu, pu, qu, v, to);
+	}
+
+	template<bool Symmetric>
+	QAP_TARGET_AVX512 static void UpdateRowAvx512(int *row, const int *x, const int *y, const int *p, const int *q, int xu, int yu, int pu, int qu, int from, int to)
+	{
+		__m512i vx = _mm512_set1_epi32(xu), vy = _mm512_set1_epi32(yu), vp = _mm512_set1_epi32(pu), vq = _mm512_set1_epi32(qu);
+		int v = from;
+		for (; v+16<=to; v+=16)
+		{
+			__m512i t1 = _mm512_mullo_epi32(_mm512_sub_epi32(vx, _mm512_loadu_si512(x+v)), _mm512_sub_epi32(vy, _mm512_loadu_si512(y+v)));
+			__m512i t2 = Symmetric ? t1 : _mm512_mullo_epi32(_mm512_sub_epi32(vp, _mm512_loadu_si512(p+v)), _mm512_sub_epi32(vq, _mm512_loadu_si512(q+v)));
+			_mm512_storeu_si512(row+v, _mm512_add_epi32(_mm512_loadu_si512(row+v), _mm512_add_epi32(t1, t2)));
+		}
+		UpdateRowScalar<Symmetric>(row, x, y, p, q, xu, yu, pu, qu, v, to);
+	}
+
+	template<bool Symmetric>
+	QAP_TARGET_AVX512 static void UpdateRowBlockAvx512(double *row, const double *x, const double *y, const double *p, const double *q, int stride, const double *xu, const double *yu, const double *pu, const double *qu, int n)
+	{
+		__m512d vx[RowBlock], vy[RowBlock], vp[RowBlock], vq[RowBlock];
+		for (int j=0; j<RowBlock; ++j)
+		{
+			vx[j] = _mm512_set1_pd(xu[j]); vy[j] = _mm512_set1_pd(yu[j]);
+			vp[j] = _mm512_set1_pd(pu[j]); vq[j] = _mm512_set1_pd(qu[j]);
+		}
+		int v = 0;
+		for (; v+8<=n; v+=8)
+		{
+			__m512d sum = _mm512_setzero_pd();
+			for (int j=0; j<RowBlock; ++j)
+			{
+				int k = j*stride + v;
+				sum = _mm512_add_pd(sum, _mm512_mul_pd(_mm512_sub_pd(vx[j], _mm512_loadu_pd(x+k)), _mm512_sub_pd(vy[j], _mm512_loadu_pd(y+k))));
+				if (!Symmetric)
+					sum = _mm512_add_pd(sum, _mm512_mul_pd(_mm512_sub_pd(vp[j], _mm512_loadu_pd(p+k)), _mm512_sub_pd(vq[j], _mm512_loadu_pd(q+k))));
+			}
+			if (Symmetric)
+				sum = _mm512_add_pd(sum, sum);
+			_mm512_storeu_pd(row+v, _mm512_add_pd(_mm512_loadu_pd(row+v), sum));
+		}
+		UpdateRowBlockScalar<Symmetric>(row, x, y, p, q, stride, xu, yu, pu, qu, v, n);
+	}
+
+	template<bool Symmetric>
+	QAP_TARGET_AVX512 static void UpdateRowBlockAvx512(int *row, const int *x, const int *y, const int *p, const int *q, int stride, const int *xu, const int *yu, const int *pu, const int *qu, int n)
+	{
+		__m512i vx[RowBlock], vy[RowBlock], vp[RowBlock], vq[RowBlock];
+		for (int j=0; j<RowBlock; ++j)
+		{
+			vx[j] = _mm512_set1_epi32(xu[j]); vy[j] = _mm512_set1_epi32(yu[j]);
+			vp[j] = _mm512_set1_epi32(pu[j]); vq[j] = _mm512_set1_epi32(qu[j]);
+		}
+		int v = 0;
+		for (; v+16<=n; v+=16)
+		{
+			__m512i sum = _mm512_setzero_si512();
+			for (int j=0; j<RowBlock; ++j)
+			{
+				int k = j*stride + v;
+				sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(_mm512_sub_epi32(vx[j], _mm512_loadu_si512(x+k)), _mm512_sub_epi32(vy[j], _mm512_loadu_si512(y+k))));
+				if (!Symmetric)
+					sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(_mm512_sub_epi32(vp[j], _mm512_loadu_si512(p+k)), _mm512_sub_epi32(vq[j], _mm512_loadu_si512(q+k))));
+			}
+			if (Symmetric)
+				sum = _mm512_add_epi32(sum, sum);
+			_mm512_storeu_si512(row+v, _mm512_add_epi32(_mm512_loadu_si512(row+v), sum));
+		}
+		UpdateRowBlockScalar<Symmetric>(row, x, y, p, q, stride, xu, yu, pu, qu, v, n);
+	}
+#endif
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "Solution.cpp"
+#include "TabuMemory.cpp"
 #include <float.h>
 #include "Global.cpp"
 #include <limits.h>
@@ -61,22 +62,20 @@ public:
 
 		int joltRate = JoltRate->Calculate(n);
 
-		bool authorized;  // move not tabu?
-		bool aspired;     // move forced?
-		bool alreadyAspired;  // In case many moves forced
 		int iBest, jBest;
-		double minDelta;
+		Cost minDelta;
 		double r;
+		bool chosen = false; // move already picked during the last update
 
 		Solution p(best);  // current solution
+		p.CachePermutedFlow();
 
-		double** tabuList = Global::CreateMatrix(n);  // Tabu status
-		for (int i = 0; i < n; ++i) 
-			for (int j = 0; j < n; ++j)
-				tabuList[i][j] = -(n*i + j);	
+		TabuMemory tabuList(n);  // Tabu status
+		tabuList.Track(p);
 		
-		double** delta = Global::CreateMatrix(n);
+		DeltaMatrix delta(n);
 		p.SwapCostMatrix(delta);
+		TabuMoveCriterion move(tabuList, aspiration); // Taillard's move choice, picked while delta is updated after the previous move
 		
 		for (int run = 1; run <= runs; ++run)
 		{
@@ -89,28 +88,18 @@ public:
 				Jolt->Enhance(p, globalIteration);
 				if (r != p.GetFitness() || JoltBest) // if jolt actually generated a new solution
 					p.SwapCostMatrix(delta); // Recalculate entire swapmatrix because a swap[s] just occurred from jolting.
+				tabuList.Refresh();
+				chosen = false;
 			}
 						
 			// Find best move (iBest, jBest) 
-			iBest = Global::Max; // in case all moves are tabu 
-			jBest = Global::Max;
-			minDelta = Global::Max;
-			alreadyAspired = false;
-
-			for (int i = 0; i < n-1; ++i) 
-				for (int j = i+1; j < n; ++j)
-				{
-					authorized = tabuList[i][p[j]] < run || tabuList[j][p[i]] < run;
-					aspired = tabuList[i][p[j]] < run - aspiration || tabuList[j][p[i]] < run - aspiration || p.GetFitness() + delta[i][j] < best.GetFitness();                
-					
-					if (aspired && !alreadyAspired || aspired && alreadyAspired && delta[i][j] < minDelta || 
-						!aspired && !alreadyAspired && delta[i][j] < minDelta && authorized)
-					{
-						iBest = i; jBest = j; minDelta = delta[i][j];
-						if (aspired) 
-							alreadyAspired = true;
-					}
-				}
+			if (!chosen || move.Run != run)
+			{
+				move.Reset(run, p, best.GetFitness());
+				Solution::ScanSwapCostMatrix(delta, move);
+			}
+			chosen = false;
+			iBest = move.I; jBest = move.J; minDelta = move.Min;
 
 			if (iBest == Global::Max) 
 				continue; //  All moves are tabu this iteration!
@@ -120,9 +109,10 @@ public:
 			
 			// Forbid reverse move for a non-uniform random number of iterations (taillard update 3/13/2006)
 			r = Global::Rand();
-			tabuList[iBest][p[jBest]] = run + (int)(r*r*r*tabuDuration);
+			tabuList.Forbid(iBest, p[jBest], run + (int)(r*r*r*tabuDuration));
 			r = Global::Rand();
-			tabuList[jBest][p[iBest]] = run + (int)(r*r*r*tabuDuration);
+			tabuList.Forbid(jBest, p[iBest], run + (int)(r*r*r*tabuDuration));
+			tabuList.Moved(iBest, jBest);
 			
 			// Best solution improved ?
 			if (p.GetFitness() < best.GetFitness())
@@ -133,9 +123,13 @@ public:
 					run = 0;
 			}
 
-			// Update matrix of move costs
+			// Update matrix of move costs and pick the next run's move
 			if (run+1 <= runs)
-				p.UpdateSwapCostMatrix(delta);
+			{
+				move.Reset(run+1, p, best.GetFitness());
+				p.UpdateSwapCostMatrix(delta, move);
+				chosen = true;
+			}
 
 
 			if (runner != NULL)
@@ -145,10 +139,6 @@ public:
 					break;
 			}
 		}
-
-		Global::DeleteMatrix(delta, n);
-		Global::DeleteMatrix(tabuList, n);
-
 	}
 };      
 
@@ -194,12 +184,15 @@ public:
 		int length = min(Length->Calculate(n),n); 
 		Permutation A(n);
 		Solution tally(solution.Problem);
+		tally.CachePermutedFlow();
 		int minIndex, bestMinIndex;
-		double minCost, bestCost, cost, fitness; 
-		double *costs = new double[length], *bestCosts = new double[length];
+		Cost minCost, bestCost, cost, fitness; 
+		Cost *costs = new Cost[length], *bestCosts = new Cost[length];
 		int *swapA = new int[length], *swapB = new int[n];
 		int *bestSwapA = new int[length], *bestSwapB = new int[length];
 		int temp;
+		Cost *row = new Cost[n];
+		bool whole;
 
 		for (int i=0; i<n; ++i)
 			swapB[i] = i;
@@ -216,9 +209,12 @@ public:
 				{
 					minCost=Global::Max;
 					swapA[i] = A[i];
+					whole = 2*(n-i) >= n; // while at least half of the row is left, evaluate all of it in one pass
+					if (whole)
+						tally.SwapCostRow(swapA[i], row);
 					for (int j=i; j<n; ++j)
 					{
-						cost = tally.SwapCost(swapA[i], swapB[j]);
+						cost = whole ? row[swapB[j]] : tally.SwapCost(swapA[i], swapB[j]);
 						if (cost < minCost)
 						{
 							minCost = cost;
@@ -304,6 +300,7 @@ public:
 		
 		delete[] costs;
 		delete[] bestCosts;
+		delete [] row;
 		delete [] swapA;
 		delete [] swapB;
 		delete [] bestSwapA;
@@ -325,7 +322,6 @@ public:
 class Peek : public LocalSearch
 {
 private:
-	double** costs;
 	int rows;	
 	
 	Ratio* Width;
@@ -335,35 +331,37 @@ public:
 
 	inline void Enhance(Solution& best, int globalIteration,  int iterations = Global::Max, Runner* runner = NULL)
 	{
-		double sumBest, sum;
+		Cost sumBest, sum;
 		int iBest, jBest, i, j, x, y;
 		bool notDone, localOpt;
-		int n = best.Size(), n2 = n*n;
-		int width = min(n2/2, Width->Calculate(n));
-		double **delta = Global::CreateMatrix(n), **delta2 = Global::CreateMatrix(n);
+		int n = best.Size(), pairs = n*(n-1)/2;
+		int width = min(pairs, Width->Calculate(n));
+		DeltaMatrix delta(n), delta2(n);
 		best.SwapCostMatrix(delta);
-		int *v = new int[n2];
-		for (int i=0; i<n2; ++i)
-			v[i] = i;
+		int *v = new int[pairs]; // i*n+j for every i < j -- only the upper triangle of delta is maintained
+		for (int i=0, k=0; i<n; ++i)
+			for (int j=i+1; j<n; ++j)
+				v[k++] = i*n + j;
 		
 		Solution p(best);
 
-		Global::FindMin(delta, n, true, i,j);
+		Global::FindMin(delta, true, i,j);
 		notDone = delta[i][j] < 0;
 		while (notDone)
 		{
-			QuickSort(v, 0, n2-1, delta, n);
+			QuickSort(v, 0, pairs-1, delta, n);
 			sumBest = Global::Max;
 			for (int k=0; k<width; ++k)
 			{
-				i = v[2*k]/n;  // array is symmetrical so the sorted output is like x,x, y,y, z,z, ..., so skip every other one.
-				j = v[2*k]%n;
+				i = v[k]/n;
+				j = v[k]%n;
 				p = best;
+				assert(i < j);
 				p.Swap(i,j, &delta[i][j]);
-				Global::CopyMatrix(delta2, delta, n);
+				Global::CopyMatrix(delta2, delta);
 				p.UpdateSwapCostMatrix(delta2);
-				Global::FindMin(delta2, n, true, x, y);
-				sum = delta[i][j] + min(0.0,delta2[x][y]); // The swap at i,j could produce a solution at a local optimum (which means all possible next swaps will be >0)
+				Global::FindMin(delta2, true, x, y);
+				sum = delta[i][j] + min((Cost)0,delta2[x][y]); // The swap at i,j could produce a solution at a local optimum (which means all possible next swaps will be >0)
 				if (sum < sumBest)
 				{
 					localOpt = delta2[x][y] > 0; // it means we're at local opt since min(delta2) > 0
@@ -374,6 +372,7 @@ public:
 			}
 			if (sumBest < 0)	
 			{
+				assert(iBest < jBest);
 				best.Swap(iBest, jBest, &delta[iBest][jBest]);
 				if (!localOpt)
 					best.UpdateSwapCostMatrix(delta);
@@ -381,11 +380,9 @@ public:
 			notDone = !localOpt;
 		}
 		delete [] v;
-		Global::DeleteMatrix(delta, n);
-		Global::DeleteMatrix(delta2, n);
 	}
 
-	inline void QuickSort(int arr[], int left, int right, double** delta, int rows) 
+	inline void QuickSort(int arr[], int left, int right, DeltaMatrix& delta, int rows) 
 	{
 		  int i = left, j = right;
 		  int tmp;
@@ -413,7 +410,7 @@ public:
 				QuickSort(arr, i, right, delta, rows);
 	}
 
-	inline bool Compare(string op, int i, int j, double** costs, int rows)
+	inline bool Compare(string op, int i, int j, DeltaMatrix& costs, int rows)
 	{
 		if (op == "<")
 			return costs[i/rows][i%rows] < costs[j/rows][j%rows];
@@ -453,12 +450,15 @@ public:
 		int minLength = Global::Constrain(MinLength->Calculate(n),0, maxLength);
 		Permutation A(n);
 		Solution tally(solution.Problem);
+		tally.CachePermutedFlow();
 		int minIndex, bestMinIndex;
-		double minCost, bestCost, cost, fitness; 
-		double *costs = new double[maxLength], *bestCosts = new double[maxLength];
+		Cost minCost, bestCost, cost, fitness; 
+		Cost *costs = new Cost[maxLength], *bestCosts = new Cost[maxLength];
 		int *swapA = new int[maxLength], *swapB = new int[n];
 		int *bestSwapA = new int[maxLength], *bestSwapB = new int[maxLength];
 		int temp;
+		Cost *row = new Cost[n];
+		bool whole;
 
 		for (int i=0; i<n; ++i)
 			swapB[i] = i;
@@ -476,9 +476,12 @@ public:
 				{
 					minCost=Global::Max;
 					swapA[i] = A[i];
+					whole = 2*(n-i) >= n; // while at least half of the row is left, evaluate all of it in one pass
+					if (whole)
+						tally.SwapCostRow(swapA[i], row);
 					for (int j=i; j<n; ++j)
 					{
-						cost = tally.SwapCost(swapA[i], swapB[j]);
+						cost = whole ? row[swapB[j]] : tally.SwapCost(swapA[i], swapB[j]);
 						if (cost < minCost)
 						{
 							minCost = cost;
@@ -540,6 +543,7 @@ public:
 		
 		delete[] costs;
 		delete[] bestCosts;
+		delete [] row;
 		delete [] swapA;
 		delete [] swapB;
 		delete [] bestSwapA;
@@ -580,12 +584,15 @@ public:
 		int minLength = Global::Constrain(MinLength->Calculate(n),0, maxLength);
 		Permutation A(n);
 		Solution tally(solution.Problem);
+		tally.CachePermutedFlow();
 		int minIndex, bestMinIndex;
-		double minCost, bestCost, cost, fitness; 
-		double *costs = new double[maxLength], *bestCosts = new double[maxLength];
+		Cost minCost, bestCost, cost, fitness; 
+		Cost *costs = new Cost[maxLength], *bestCosts = new Cost[maxLength];
 		int *swapA = new int[maxLength], *swapB = new int[n];
 		int *bestSwapA = new int[maxLength], *bestSwapB = new int[maxLength];
 		int temp;
+		Cost *row = new Cost[n];
+		bool whole;
 
 		for (int i=0; i<n; ++i)
 			swapB[i] = i;
@@ -604,9 +611,12 @@ public:
 				{
 					minCost=Global::Max;
 					swapA[i] = A[i];
+					whole = 2*(n-i) >= n; // while at least half of the row is left, evaluate all of it in one pass
+					if (whole)
+						tally.SwapCostRow(swapA[i], row);
 					for (int j=i; j<n; ++j)
 					{
-						cost = tally.SwapCost(swapA[i], swapB[j]);
+						cost = whole ? row[swapB[j]] : tally.SwapCost(swapA[i], swapB[j]);
 						if (cost < minCost)
 						{
 							minCost = cost;
@@ -665,6 +675,7 @@ public:
 		
 		delete[] costs;
 		delete[] bestCosts;
+		delete [] row;
 		delete [] swapA;
 		delete [] swapB;
 		delete [] bestSwapA;
@@ -696,17 +707,16 @@ public:
 	{
 		int n = best.Size(), minIndex, bestMinIndex, minForbidIndex, temp, iteration, swaps, a, b;
 		int maxSwaps = Swaps->Calculate(n);
-		double minCost, bestCost, minForbidCost, cost, r, *costs = new double[n], *bestCosts = new double[n];
+		Cost minCost, bestCost, minForbidCost, cost, *costs = new Cost[n], *bestCosts = new Cost[n], *row = new Cost[n];
+		double r;
 		int *swapA = new int[n], *swapB = new int[n], *bestSwapA = new int[n], *bestSwapB = new int[n];
 		int tabuDuration = U->Calculate(n);
 		Permutation A(n);
 		Solution p = best, tally(p.Problem);
-		bool authorized;
+		tally.CachePermutedFlow();
+		bool authorized, whole;
 		
-		double** tabuList = Global::CreateMatrix(n);  // Tabu status
-		for (int i = 0; i < n; ++i) 
-			for (int j = 0; j < n; ++j)
-				tabuList[i][j] = -(n*i + j);	
+		TabuMemory tabuList(n);  // Tabu status
 		
 		for (int i=0; i<n; ++i)
 			swapB[i] = i;
@@ -723,11 +733,14 @@ public:
 				{
 					minCost=minForbidCost=Global::Max;
 					swapA[i] = A[i];
+					whole = 2*(n-i) >= n; // while at least half of the row is left, evaluate all of it in one pass
+					if (whole)
+						tally.SwapCostRow(swapA[i], row);
 					for (int j=i; j<n; ++j)
 					{
 						a = swapA[i]; b = swapB[j];
-						cost = tally.SwapCost(a, b);
-						authorized = tabuList[a][tally[b]] < swaps + i || tabuList[b][tally[a]] < swaps + i ||
+						cost = whole ? row[b] : tally.SwapCost(a, b);
+						authorized = tabuList.Until(a, tally[b]) < swaps + i || tabuList.Until(b, tally[a]) < swaps + i ||
 									 tally.GetFitness() + cost < best.GetFitness(); // authorized if not tabu or gives better best solution.
 						if (cost < minForbidCost)
 						{
@@ -786,9 +799,9 @@ public:
 				p.Swap(a, b, &bestCosts[i]);
 				// Forbid reverse move for a non-uniform random number of iterations (taillard update 3/13/2006)
 				r = Global::Rand();
-				tabuList[a][p[b]] = swaps + (int)(r*r*r*tabuDuration);
+				tabuList.Forbid(a, p[b], swaps + (int)(r*r*r*tabuDuration));
 				r = Global::Rand();
-				tabuList[b][p[a]] = swaps + (int)(r*r*r*tabuDuration);
+				tabuList.Forbid(b, p[a], swaps + (int)(r*r*r*tabuDuration));
 				++swaps;
 			}
 
@@ -801,11 +814,11 @@ public:
 		
 		delete[] costs;
 		delete[] bestCosts;
+		delete [] row;
 		delete [] swapA;
 		delete [] swapB;
 		delete [] bestSwapA;
 		delete [] bestSwapB;
-		Global::DeleteMatrix(tabuList,n);
 	}
 
 	string ParmsToString()
@@ -834,10 +847,12 @@ public:
 		int n = best.Size();
 		int length = Length->Calculate(n);
 		best.GetFitness(); // force fitness calculation if needed
-		double fitness, minCost, cost;
+		Cost fitness, minCost, cost;
 		int minIndex;
 		Solution p(best.Problem), tally(best.Problem);
+		tally.CachePermutedFlow();
 		Permutation A(n);
+		Cost *row = new Cost[n];
 
 		bool bestUpdated;
 		int iteration = 1;
@@ -855,9 +870,10 @@ public:
 					for (int i=0; i<n && l<length; ++i,++l)
 					{	
 						minCost = Global::Max;
+						tally.SwapCostRow(A[i], row);
 						for (int j=0; j<n; ++j)
 						{
-							cost = tally.SwapCost(A[i],j);  
+							cost = row[j];  
 							if (cost < minCost) // Remember you can swap with yourself so minCost <= 0 always.
 							{
 								minCost = cost; 
@@ -886,6 +902,7 @@ public:
 			++iteration;
 		} while (bestUpdated && iteration <= iterations);
 
+		delete [] row;
 	}
 
 	string ParmsToString() 
@@ -913,16 +930,18 @@ public:
 		int n = best.Size();
 		int length = Length->Calculate(n);
 		int maxSwaps = Swaps->Calculate(n); 
-		double minCost, cost, bestTallyCost, r;
+		Cost minCost, cost, bestTallyCost;
+		double r;
 		int minIndex, u = U->Calculate(n), a, b;
 		best.GetFitness(); // force fitness calculation if needed
 		Solution p = best, tally(best.Problem);
+		tally.CachePermutedFlow();
 		Permutation A(n);
 		
 
-		double** tabuList = Global::CreateMatrix(n,0);
+		TabuMemory tabuList(n, false);
 		int *swapA = new int[length], *swapB = new int[length], *bestSwapA = new int[length], *bestSwapB = new int[length];
-		double *costs = new double[length], *bestCosts = new double[length];
+		Cost *costs = new Cost[length], *bestCosts = new Cost[length], *row = new Cost[n];
 
 		bool bestUpdated, authorized;
 		int iteration = 1, swaps = 1;
@@ -940,14 +959,15 @@ public:
 					{	
 						bestTallyCost = Global::Max;
 						minCost = Global::Max;
+						tally.SwapCostRow(A[i], row);
 						for (int j=0; j<n; ++j)
 						{
 							a = A[i]; 
 							b = j;
 
-							cost = tally.SwapCost(a,b); 
+							cost = row[j]; 
 							
-							authorized = tabuList[a][tally[b]] < swaps + i || tabuList[b][tally[a]] < swaps + i ||
+							authorized = tabuList.Until(a, tally[b]) < swaps + i || tabuList.Until(b, tally[a]) < swaps + i ||
 										  tally.GetFitness() + cost < best.GetFitness();
 
 							if (cost < minCost && authorized)
@@ -991,9 +1011,9 @@ public:
 				p.Swap(a,b,&bestCosts[i]);
 				// Forbid reverse move for a non-uniform random number of iterations (taillard update 3/13/2006)
 				r = Global::Rand();
-				tabuList[a][p[b]] = swaps + (int)(r*r*r*u);
+				tabuList.Forbid(a, p[b], swaps + (int)(r*r*r*u));
 				r = Global::Rand();
-				tabuList[b][p[a]] = swaps + (int)(r*r*r*u);
+				tabuList.Forbid(b, p[a], swaps + (int)(r*r*r*u));
 				++swaps;			
 			}
 
@@ -1002,9 +1022,9 @@ public:
 			++iteration;
 		} while (iteration <= iterations && swaps <= maxSwaps);
 
-		Global::DeleteMatrix(tabuList,n);
 		delete [] costs;
 		delete [] bestCosts;
+		delete [] row;
 		delete [] swapA;
 		delete [] swapB;
 		delete [] bestSwapA;
@@ -1035,8 +1055,8 @@ public:
 		int n = solution.Size();
 		Permutation a(n), b(n);
 		int length = Length->Calculate(n);
-		bool swapped;
-		double cost;
+		bool swapped, whole;
+		Cost cost, *row = solution.IsPermutedFlowCached() ? new Cost[n] : NULL;
 
 		while (true)
 		{
@@ -1045,12 +1065,16 @@ public:
 			for (int i=0; i<n; ++i)
 			{
 				b.Randomize();
+				whole = row != NULL && length >= n; // the row is good until the next swap, then it's back to single costs
+				if (whole)
+					solution.SwapCostRow(a[i], row);
 				for (int j=0; j<n; ++j)
 				{
-					if ((cost=solution.SwapCost(a[i],b[j])) < 0)
+					if ((cost=whole ? row[b[j]] : solution.SwapCost(a[i],b[j])) < 0)
 					{	
 						solution.Swap(a[i],b[j],&cost);
 						swapped = true;
+						whole = false;
 					}
 					--length;
 					if (length <= 0) break;
@@ -1058,7 +1082,7 @@ public:
 			}
 			if (!swapped) break; // we considered all neighbors which means we're at a local optima.  
 		} 
-
+		delete [] row;
 	}
 	string ParmsToString() 
 	{
@@ -1083,7 +1107,7 @@ public:
 		int n = best.Size();
 		int armLength = Length->Calculate(n);
 		best.GetFitness(); // force fitness calculation if need be
-		double fitness;
+		Cost fitness;
 		Solution p(best.Problem), tally(best.Problem);
 
 		bool bestUpdated;
@@ -1118,8 +1142,8 @@ public:
 	{
 		Permutation a(solution.Size()), b(solution.Size());
 		int n = solution.Size();
-		double cost;
-		bool swapped = false;
+		Cost cost, *row = solution.IsPermutedFlowCached() ? new Cost[n] : NULL;
+		bool swapped = false, whole;
 		int currentTimes = 0;
 		while (true)
 		{
@@ -1127,16 +1151,23 @@ public:
 			for (int i=0; i<n; ++i)
 			{
 				b.Randomize();
+				whole = row != NULL && totalTimes - currentTimes >= n; // good until the next swap, as in FastDescent
+				if (whole)
+					solution.SwapCostRow(a[i], row);
 				for (int j=0; j<n; ++j)
 				{
-					if ((cost=solution.SwapCost(a[i],b[j])) < 0)
+					if ((cost=whole ? row[b[j]] : solution.SwapCost(a[i],b[j])) < 0)
 					{	
 						solution.Swap(a[i],b[j],&cost);
 						swapped = true;
+						whole = false;
 					}
 					++currentTimes;
 					if (currentTimes >= totalTimes)
+					{
+						delete [] row;
 						return swapped;
+					}
 				}
 			}
 		}
@@ -1158,31 +1189,21 @@ public:
 	inline void Enhance(Solution& solution, int globalIteration, int iterations=Global::Max, Runner* runner = NULL)
 	{
 		int n = solution.Size();
-		double min;
-		double **cost = Global::CreateMatrix(n);
+		Cost min;
+		DeltaMatrix cost(n);
 		solution.SwapCostMatrix(cost);
-		int r,s;
 		int iteration = 1;
-		do
+		MinSwapCriterion move;
+		Solution::ScanSwapCostMatrix(cost, move);
+		while (move.Min < 0)
 		{
-			min = Global::Max; 
-			for (int i=0; i<n; ++i)
-				for (int j=i+1; j<n; ++j)
-					if (cost[i][j] < min)
-					{
-						min = cost[i][j];
-						r = i;
-						s = j;
-					}
-			if (min < 0)
-			{
-				solution.Swap(r,s, &min);
-				if (iteration+1 <= iterations)
-					solution.UpdateSwapCostMatrix(cost);
-			}
-			++iteration;
-		} while (min < 0 && iteration <= iterations);
-		Global::DeleteMatrix(cost,n);
+			min = move.Min;
+			solution.Swap(move.I, move.J, &min);
+			move.Reset();
+			if (++iteration > iterations)
+				break;
+			solution.UpdateSwapCostMatrix(cost, move); // picks the next move in the same pass
+		}
 	}
 };
 
@@ -1196,7 +1217,7 @@ public:
 
 	inline bool BestImprovement(Solution& solution)
 	{
-		double min = Global::Max, minPart, total, part;
+		Cost min = Global::Max, minPart, total, part;
 		int r,s,t;
 		for (int i=0; i<solution.Size(); ++i)
 			for (int j=0; j<solution.Size(); ++j)
@@ -1220,7 +1241,7 @@ public:
 		if (min < 0)
 		{
 			solution.Swap(r,s,&minPart); // Put 0 here or else it will internally clear fitness due to a swap.
-			double cost = min-minPart;
+			Cost cost = min-minPart;
 			solution.Swap(s,t,&cost);
 		}
 		return min < 0;
@@ -1243,13 +1264,15 @@ public:
 		int n = best.Size(), power, cycle, fails, failCount = FailCount->Calculate(n), bestI, bestJ;
 
 		Solution p = best;
-		double** delta = Global::CreateMatrix(n);
+		p.CachePermutedFlow();
+		DeltaMatrix delta(n);
 		p.SwapCostMatrix(delta); // populate with costs.
 	
 		cycle = 0, power = StartPower, fails = 0;
 		while (cycle < Cycles)
 		{
-			Global::InverseRoulette(delta,n,true,best.GetFitness()-p.GetFitness(), power, &bestI, &bestJ);
+			Global::InverseRoulette(delta,true,best.GetFitness()-p.GetFitness(), power, &bestI, &bestJ);
+			assert(bestI < bestJ);
 			p.Swap(bestI, bestJ, &delta[bestI][bestJ]);
 			p.UpdateSwapCostMatrix(delta);
 			if (p.GetFitness() < best.GetFitness())
@@ -1273,7 +1296,6 @@ public:
 			}
 		}
 
-		Global::DeleteMatrix(delta, n);
 	}
 
 	string ParmsToString()
@@ -91,7 +91,7 @@ public:
 							int r1 = Global::Rand(s.Size());
 							int r2;
 							while ((r2 = Global::Rand(s.Size())) == r1) {}
-							double cost = s.SwapCost(r1,r2);
+							Cost cost = s.SwapCost(r1,r2);
 							s.Swap(r1,r2, &cost);
 						}
 					}
@@ -7,15 +7,40 @@
 #include <assert.h>
 #include "Setup.cpp"
 #include <limits>
+#include <new>
+#include <cstdlib>
 
 using namespace std;
 
-MTRand Global::Twister;
+RandomGenerator Global::Shared;
+QAP_THREAD RandomGenerator* Global::Stream = NULL;
+unsigned long long Global::Seed = 0;
 fstream Global::Log;
 int Global::Max = INT_MAX;
 int Global::Min = INT_MIN;
 int AlgoParms::count = 0;
 
+#ifdef QAP_COUNT_ALLOCATIONS
+atomic<size_t> Benchmark::Allocations(0);
+
+// Counts heap allocations for Benchmark, from any thread; only the count is needed, so no ordering.  Every form of
+// new and delete is replaced so they all pair up, and all stay out of line: inlined, GCC would match the malloc and
+// free calls inside against the operator new and delete calls at the other end and report them as mismatched.
+QAP_NOINLINE void* operator new(size_t size)
+{
+	Benchmark::Allocations.fetch_add(1, memory_order_relaxed);
+	void *p = malloc(size > 0 ? size : 1);
+	if (p == NULL)
+		throw bad_alloc();
+	return p;
+}
+QAP_NOINLINE void* operator new[](size_t size) { return operator new(size); }
+QAP_NOINLINE void operator delete(void* p) throw() { free(p); }
+QAP_NOINLINE void operator delete[](void* p) throw() { free(p); }
+QAP_NOINLINE void operator delete(void* p, size_t) throw() { free(p); }
+QAP_NOINLINE void operator delete[](void* p, size_t) throw() { free(p); }
+#endif
+
 
 int main()
 {
@@ -0,0 +1,200 @@
+#pragma once
+#include <cstring>
+#include <cstddef>
+#include <new>
+#include <assert.h>
+
+using namespace std;
+
+// Square n x n matrix stored row-major in one contiguous 64-byte aligned block.
+// Each row is padded to a whole number of cache lines so every row starts aligned; the padding is kept at zero.
+// m[i][j] indexing works exactly like the old double** layout.
+template<typename T>
+class BasicMatrix
+{
+private:
+	char *Block;
+	T *Values;
+	BasicMatrix(const BasicMatrix&);  // not copyable -- use Global::CopyMatrix
+	BasicMatrix& operator=(const BasicMatrix&);
+public:
+	typedef T Element;
+	static const bool UpperOnly = false;
+	static const int Alignment = 64; // bytes
+	int Size;   // rows/columns in use
+	int Stride; // elements between the start of two consecutive rows (>= Size)
+
+	BasicMatrix() : Block(NULL), Values(NULL), Size(0), Stride(0) {}
+	BasicMatrix(int n) : Block(NULL), Values(NULL), Size(0), Stride(0) { Create(n); }
+	~BasicMatrix() { Delete(); }
+
+	inline void Create(int n)
+	{
+		Delete();
+		int perLine = Alignment / sizeof(T);
+		Size = n;
+		Stride = (n + perLine-1) / perLine * perLine;
+		size_t bytes = (size_t)Size * Stride * sizeof(T);
+		Block = new char[bytes + Alignment];
+		Values = (T*)(((size_t)Block + Alignment-1) & ~(size_t)(Alignment-1));
+		// Value-initialized in place rather than memset, so element types that are not plain data (the atomic<int>
+		// of MultiGLS's shared matrices) are constructed properly; for numbers this compiles to the same zero fill.
+		// Elements are never destroyed, so T must be trivially destructible.
+		for (size_t k=0; k<Count(); ++k)
+			new (Values + k) T();
+	}
+
+	inline void Delete()
+	{
+		delete [] Block;
+		Block = NULL;
+		Values = NULL;
+		Size = Stride = 0;
+	}
+
+	inline void Fill(T value)
+	{
+		for (int i=0; i<Size; ++i)
+		{
+			T *row = Values + (size_t)i*Stride;
+			for (int j=0; j<Size; ++j)
+				row[j] = value;
+		}
+	}
+
+	inline bool IsEmpty() const { return Values == NULL; }
+	inline size_t Count() const { return (size_t)Size * Stride; } // elements in the block, padding included
+	inline T* Data() { return Values; }
+	inline const T* Data() const { return Values; }
+	inline T* operator[](int i) { return Values + (size_t)i*Stride; }
+	inline const T* operator[](int i) const { return Values + (size_t)i*Stride; }
+};
+
+typedef BasicMatrix<double> Matrix;
+
+// Upper triangle (diagonal included) of a square n x n matrix, packed row after row into n(n+1)/2 elements.
+// Row i holds columns i..n-1, so m[i][j] is only valid for j >= i, and a loop over i then j > i walks the block
+// front to back.  Used for swap cost matrices, where (i,j) and (j,i) are the same move.
+template<typename T>
+class TriangularMatrix
+{
+private:
+	char *Block;
+	T *Values;
+	TriangularMatrix(const TriangularMatrix&);  // not copyable -- use Global::CopyMatrix
+	TriangularMatrix& operator=(const TriangularMatrix&);
+	inline size_t RowOffset(int i) const { return (size_t)i*Size - (size_t)i*(i-1)/2 - i; } // start of row i minus i
+public:
+	typedef T Element;
+	static const bool UpperOnly = true;
+	static const int Alignment = 64; // bytes
+	int Size;
+
+	TriangularMatrix() : Block(NULL), Values(NULL), Size(0) {}
+	TriangularMatrix(int n) : Block(NULL), Values(NULL), Size(0) { Create(n); }
+	~TriangularMatrix() { Delete(); }
+
+	inline void Create(int n)
+	{
+		Delete();
+		Size = n;
+		size_t bytes = Count() * sizeof(T);
+		Block = new char[bytes + Alignment];
+		Values = (T*)(((size_t)Block + Alignment-1) & ~(size_t)(Alignment-1));
+		memset(Values, 0, bytes);
+	}
+
+	inline void Delete()
+	{
+		delete [] Block;
+		Block = NULL;
+		Values = NULL;
+		Size = 0;
+	}
+
+	inline void Fill(T value)
+	{
+		for (size_t k=0; k<Count(); ++k)
+			Values[k] = value;
+	}
+
+	inline bool IsEmpty() const { return Values == NULL; }
+	inline size_t Count() const { return (size_t)Size*(Size+1)/2; }
+	inline T* Data() { return Values; }
+	inline const T* Data() const { return Values; }
+#ifdef NDEBUG
+	inline T* operator[](int i) { return Values + RowOffset(i); }
+	inline const T* operator[](int i) const { return Values + RowOffset(i); }
+#else
+	// Debug builds hand out checked rows: only m[i][j] with i <= j < Size is stored.
+	template<typename E>
+	struct Row
+	{
+		E *Values;
+		int I, Size;
+		Row(E *values, int i, int size) : Values(values), I(i), Size(size) {}
+		inline operator E*() const { return Values; }
+		inline E& operator[](int j) const { assert(I <= j && j < Size); return Values[j]; }
+	};
+	inline Row<T> operator[](int i) { assert(0 <= i && i < Size); return Row<T>(Values + RowOffset(i), i, Size); }
+	inline Row<const T> operator[](int i) const { assert(0 <= i && i < Size); return Row<const T>(Values + RowOffset(i), i, Size); }
+#endif
+};
+
+// Compressed sparse rows of a square matrix: the nonzeros of row i are Value[Start[i]..Start[i+1]) in columns
+// Index[...], in increasing column order.  Built once from a dense matrix (optionally transposed, which gives the
+// compressed columns) and read only after that.
+template<typename T>
+class SparseMatrix
+{
+private:
+	SparseMatrix(const SparseMatrix&);
+	SparseMatrix& operator=(const SparseMatrix&);
+public:
+	int Size;
+	int *Start, *Index;
+	T *Value;
+
+	SparseMatrix() : Size(0), Start(NULL), Index(NULL), Value(NULL) {}
+	~SparseMatrix() { Delete(); }
+
+	inline void Create(const BasicMatrix<T>& m, bool transpose=false)
+	{
+		Delete();
+		Size = m.Size;
+		Start = new int[Size+1];
+		Start[0] = 0;
+		for (int i=0; i<Size; ++i)
+		{
+			Start[i+1] = Start[i];
+			for (int j=0; j<Size; ++j)
+				if ((transpose ? m[j][i] : m[i][j]) != 0)
+					++Start[i+1];
+		}
+		Index = new int[Start[Size]];
+		Value = new T[Start[Size]];
+		for (int i=0, k=0; i<Size; ++i)
+			for (int j=0; j<Size; ++j)
+			{
+				T v = transpose ? m[j][i] : m[i][j];
+				if (v != 0)
+				{
+					Index[k] = j;
+					Value[k++] = v;
+				}
+			}
+	}
+
+	inline void Delete()
+	{
+		delete [] Start;
+		delete [] Index;
+		delete [] Value;
+		Start = Index = NULL;
+		Value = NULL;
+		Size = 0;
+	}
+
+	inline bool IsEmpty() const { return Start == NULL; }
+	inline int NonZeros() const { return Start == NULL ? 0 : Start[Size]; }
+};
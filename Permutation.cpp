@@ -1,5 +1,6 @@
 #pragma once
 
+#include <utility>
 #include "Global.cpp"
 using namespace std;
 
@@ -19,6 +20,18 @@ public:
 	{ 
 		delete [] Values; 
 	}
+	// Moving constructs by taking over the values buffer, leaving the source empty; move assignment exchanges buffers.
+	Permutation(Permutation&& p) : Values(p.Values), Size(p.Size)
+	{
+		p.Values = NULL;
+		p.Size = 0;
+	}
+	Permutation& operator=(Permutation&& p)
+	{
+		std::swap(Values, p.Values);
+		std::swap(Size, p.Size);
+		return *this;
+	}
 
 	inline int& operator[](int index) { return Values[index]; }
 	inline void Swap(int i, int j)
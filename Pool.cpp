@@ -76,7 +76,7 @@ public:
 	Pool* PerturbPool()
 	{
 		int j=0;
-		double cost;
+		Cost cost;
 		Pool *pool = new Pool(Run, Parms);
 		Solution rand(Problem);
 		int mod = Problem.Size % 2 == 0 ? Problem.Size : Problem.Size-1;
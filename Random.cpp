@@ -0,0 +1,56 @@
+#pragma once
+
+// xoshiro256** (Blackman and Vigna): 256 bits of state and a handful of shifts, rotations and one multiply per 64-bit
+// draw, against MT19937's 2.5KB state, block reload and tempering.  It answers the same randInt/rand calls as MTRand
+// so either can sit behind Global::Rand, and adds Fill for loops that want a batch of draws at once.
+class Xoshiro256
+{
+private:
+	unsigned long long State[4];
+
+	static inline unsigned long long Rotate(unsigned long long x, int k) { return (x << k) | (x >> (64 - k)); }
+public:
+	typedef unsigned long uint32; // as MTRand::uint32
+
+	Xoshiro256(unsigned long long seed=0) { Seed(seed); }
+
+	// State from four SplitMix64 outputs, which are never all zero.
+	inline void Seed(unsigned long long seed)
+	{
+		for (int k=0; k<4; ++k)
+		{
+			unsigned long long z = (seed += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			State[k] = z ^ (z >> 31);
+		}
+	}
+
+	inline unsigned long long Next()
+	{
+		unsigned long long *s = State;
+		unsigned long long result = Rotate(s[1] * 5, 7) * 9;
+		unsigned long long t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = Rotate(s[3], 45);
+		return result;
+	}
+
+	// Integer in [0,2^32-1]
+	inline uint32 randInt() { return uint32(Next() >> 32); }
+	// Integer in [0,n], by multiplying the high 32 bits into range instead of dividing (bias below (n+1)/2^32).
+	inline uint32 randInt(uint32 n) { return uint32(((Next() >> 32) * ((unsigned long long)n + 1)) >> 32); }
+	// Real number in [0,1), from the high 53 bits.
+	inline double rand() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+	// count draws of rand() into values, in the order rand() would give them.
+	inline void Fill(double *values, int count)
+	{
+		for (int k=0; k<count; ++k)
+			values[k] = (Next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+};
@@ -17,8 +17,10 @@ public:
 	Instance& Problem;
 	int Runs, Iteration;
 	int Iterations;
+	int Threads; // replicates run at once; 1 runs them one after another
+	unsigned long long Seed; // replicate i draws from stream Global::Derive(Seed, i)
 
-	Runner(Instance& problem, int runs, int time, int iterations) : Problem(problem), Optimal(problem.OptimalFitness), Runs(runs), Time(time), Iterations(iterations) {}
+	Runner(Instance& problem, int runs, int time, int iterations, int threads=1) : Problem(problem), Optimal(problem.OptimalFitness), Runs(runs), Time(time), Iterations(iterations), Threads(threads), Seed(Global::NewSeed()) {}
 	
 	inline void Run()
 	{
@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include "Crew.cpp"
+
+using namespace std;
+
+// Work-stealing pool for long independent tasks such as the cells of an experiment grid.  Tasks are dealt to the
+// workers in turn as they are added, so adding them longest first hands every worker its share of long ones first.
+// Each worker takes the front of its own queue and, once that is empty, steals the front of the next worker's that
+// is not, so the remaining long tasks are picked up first wherever they sit.  Run returns when every task is done.
+class Scheduler
+{
+private:
+	struct Queue
+	{
+		mutex Lock;
+		deque<function<void()> > Tasks;
+	};
+	vector<Queue*> Queues;
+	int Next; // worker dealt the next task added
+	Scheduler(const Scheduler&);
+	Scheduler& operator=(const Scheduler&);
+
+	inline bool Take(int worker, function<void()>& task)
+	{
+		int workers = (int)Queues.size();
+		for (int k=0; k<workers; ++k)
+		{
+			Queue &queue = *Queues[(worker + k) % workers];
+			unique_lock<mutex> lock(queue.Lock);
+			if (!queue.Tasks.empty())
+			{
+				task = queue.Tasks.front();
+				queue.Tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+public:
+	Scheduler(int workers) : Next(0)
+	{
+		for (int w=0; w<max(workers, 1); ++w)
+			Queues.push_back(new Queue());
+	}
+	~Scheduler()
+	{
+		for (int w=0; w<Workers(); ++w)
+			delete Queues[w];
+	}
+
+	inline int Workers() const { return (int)Queues.size(); }
+
+	// Tasks may only be added while the pool is not running.
+	inline void Add(const function<void()>& task)
+	{
+		Queues[Next]->Tasks.push_back(task);
+		Next = (Next + 1) % Queues.size();
+	}
+
+	// Runs every task added, on Workers() threads counting the calling one.
+	void Run()
+	{
+		Crew crew(Workers());
+		crew.Run([this](int worker)
+		{
+			function<void()> task;
+			while (Take(worker, task))
+				task();
+		});
+		Next = 0;
+	}
+};
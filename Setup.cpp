@@ -1,6 +1,7 @@
 
 #pragma once
 #include <vector>
+#include <algorithm>
 #include "Algorithm.cpp"
 #include "AlgoParms.cpp"
 #include "MyITS.cpp"
@@ -10,9 +11,11 @@
 #include "Runner.cpp"
 #include "LocalSearchAnalysis.cpp"
 #include "ParticleSwarmOptimization.cpp"
+#include "Benchmark.cpp"
+#include "Scheduler.cpp"
 
 using namespace std;
-enum RunMode { AlgorithmMode, LocalSearchMode, ParameterOptimizationMode};
+enum RunMode { AlgorithmMode, LocalSearchMode, ParameterOptimizationMode, BenchmarkMode, VerifyMode};
 
 class Setup
 {
@@ -23,6 +26,9 @@ private:
 	vector<Parameter*> Parms;
 	string FileName, Description;
 	int Runs, RunTime, Iterations, RunsPerInstance, SwarmSize;
+	int Threads; // replicates of a cell run at once
+	int Workers; // cells of the grid run at once
+	unsigned long long Seed; // master random seed; 0 draws a fresh one, which the results file records
 	bool Reset;
 	RunMode Mode;
 public:
@@ -30,11 +36,16 @@ public:
 	{
 		//Mode = ParameterOptimizationMode;
 		Mode = AlgorithmMode;
+		Threads = 1;
+		Workers = 1;
+		Seed = 0;
 		
 		switch (Mode)
 		{
 			case LocalSearchMode: SetupSearches(); SetupInstances(); break;
 			case ParameterOptimizationMode: SetupParameters(); SetupParameterOptimizerInstances(); break;
+			case BenchmarkMode: SetupBenchmarkInstances(); break;
+			case VerifyMode: SetupVerification(); break;
 			default: 
 			case AlgorithmMode: SetupAlgos(); SetupInstances(); break;
 		}
@@ -59,6 +70,63 @@ public:
 			Instances.push_back(new Instance(instanceNames[i]));
 	}
 
+	void SetupBenchmarkInstances()
+	{
+		RunTime = 5; // seconds per instance
+		// Increasing n, so throughput can be read against problem size
+		string instanceNames[] = {
+			"nug12","nug20","esc32a","nug30","tai50a","tai64c","tai80a","tai100a","esc128","tai150b","tai256c" 
+		};
+		for (int i=0; i<(int)(sizeof(instanceNames)/sizeof(string)); ++i) 
+			Instances.push_back(new Instance(instanceNames[i]));
+	}
+
+	// Regression checks run by VerifyMode: no search may report a fitness below a proven optimum.  Debug makes GLS
+	// check its kept fitness after every swap too, which is what catches a bad swap cost under RandomMovePr=1, where
+	// no iteration ends before the run time is up.
+	void SetupVerification()
+	{
+		Runs = 2;
+		RunTime = 5;
+		Iterations = Global::Max;
+		GLS* gls; GLSParms* g;
+		Algos.push_back(gls= new GLS()); g=gls->Parms; g->RandomMovePr = 1; g->Debug = true;
+		Algos.push_back(gls= new GLS()); g=gls->Parms; g->RandomMovePr = .3; g->Debug = true;
+
+		string instanceNames[] = {
+			"nug30","bur26a","chr25a","tai20a","esc32a","tai64c" 
+		};
+		for (int i=0; i<(int)(sizeof(instanceNames)/sizeof(string)); ++i) 
+			Instances.push_back(new Instance(instanceNames[i]));
+	}
+
+	void Verify()
+	{
+		int failures = 0, rows = (int)Instances.size(), cols = (int)Algos.size();
+		for (int i=0; i<rows; ++i)
+			for (int j=0; j<cols; ++j)
+			{
+				Runner run(*Instances[i], Runs, RunTime, Iterations);
+				run.Seed = Global::Derive(Global::Derive(Global::Seed, i), j);
+				Result* result = Algos[j]->Run(run);
+				bool passed = result->Fitness.Min >= Instances[i]->OptimalFitness;
+				cout << fixed << setprecision(0) << (passed ? "ok     " : "FAILED ") << Instances[i]->InstanceName << " opt=" << Instances[i]->OptimalFitness << " best=";
+				if (result->Fitness.Min < Global::Max)
+					cout << result->Fitness.Min;
+				else
+					cout << "none"; // no iteration ended within the run time
+				cout << "  " << Algos[j]->GetParms()->ToString() << endl;
+				if (!passed)
+					++failures;
+				delete result;
+			}
+		if (failures > 0)
+		{
+			cerr << failures << " verification runs beat a proven optimum" << endl;
+			exit(1);
+		}
+	}
+
 	void SetupInstances()
 	{
 		// Initialize Benchmarks
@@ -97,6 +165,8 @@ public:
 		Runs = 5;
 		RunTime = 15 * 60; 
 		Iterations = Global::Max;
+		//Threads = Runs; // all replicates of a cell at once
+		//Workers = 4; // cells of the grid at once, each running Threads replicates at once
 
 		
 		// - - - - - - - - - - - - - - - SEVENTH - - - - - - - - - - - - - - - - -
@@ -804,8 +874,68 @@ public:
 
 
 
+	// Runs every instance x algorithm cell of the grid on Workers threads that steal cells from each other, cells of
+	// the largest instances first so the longest ones don't start last.  Each cell has a seed of its own and the grid
+	// prints cells in grid order whatever order they finish in, so the results don't depend on Workers.  A cell runs
+	// on a replica of its algorithm; an algorithm without replicas runs all its cells in turn as a single task.
+	void RunGrid(Grid& grid)
+	{
+		int rows = (int)Instances.size(), cols = (int)Algos.size(), workers = Workers;
+		vector<Runner*> runs;
+		for (int i=0; i<rows; ++i)
+			for (int j=0; j<cols; ++j)
+			{
+				runs.push_back(new Runner(*Instances[i], Runs, RunTime, Iterations, Threads));
+				runs.back()->Seed = Global::Derive(Global::Derive(Global::Seed, i), j); // by cell, so a cell repeats on its own
+			}
+		for (int j=0; j<cols; ++j)
+			if (Algos[j]->GetParms()->Debug)
+				workers = 1; // verifying the kernels switches the level every search uses
+
+		vector<int> order; // instances, largest first when cells run at once
+		for (int i=0; i<rows; ++i)
+			order.push_back(i);
+		if (workers > 1)
+			stable_sort(order.begin(), order.end(), [this](int a, int b) { return Instances[a]->Size > Instances[b]->Size; });
+
+		Scheduler pool(workers);
+		vector<bool> replicable(cols, false);
+		for (int j=0; j<cols; ++j)
+		{
+			Algorithm *probe = workers > 1 ? Algos[j]->Replica() : NULL;
+			replicable[j] = probe != NULL;
+			delete probe;
+			if (!replicable[j] && workers > 1)
+				pool.Add([&, j]()
+				{
+					for (int k=0; k<rows; ++k)
+						grid.Add(order[k]*cols + j, Algos[j]->Run(*runs[order[k]*cols + j]));
+				});
+		}
+		for (int k=0; k<rows; ++k)
+			for (int j=0; j<cols; ++j)
+			{
+				int cell = order[k]*cols + j;
+				if (workers == 1)
+					pool.Add([&, cell, j]() { grid.Add(cell, Algos[j]->Run(*runs[cell])); });
+				else if (replicable[j])
+					pool.Add([&, cell, j]()
+					{
+						Algorithm *replica = Algos[j]->Replica();
+						Result *result = replica->Run(*runs[cell]);
+						delete replica;
+						grid.Add(cell, result);
+					});
+			}
+		pool.Run();
+
+		for (int c=0; c<rows*cols; ++c)
+			delete runs[c];
+	}
+
 	void Run()
 	{
+		Global::Reseed(Seed != 0 ? Seed : Global::FreshSeed());
 
 		if (Mode == LocalSearchMode)
 		{
@@ -816,14 +946,7 @@ public:
 		{
 			Grid grid(FileName, Description, Runs, RunTime, Iterations, Algos);
 			grid.PrintHeader();
-			for (int i=0; i<Instances.size(); ++i)
-				for (int j=0; j<Algos.size(); ++j)
-				{
-					Runner run(*Instances[i], Runs, RunTime, Iterations); 
-					Result* result = Algos[j]->Run(run);
-					grid.Print(*result);
-					delete result;
-				}
+			RunGrid(grid);
 			grid.PrintFooter();
 		}
 		else if (Mode == ParameterOptimizationMode)
@@ -831,6 +954,13 @@ public:
 			ParticleSwarmOptimization particle(FileName, Algos[0], Parms, Instances);
 			particle.Run(SwarmSize, Iterations, Runs, RunTime);
 		}
+		else if (Mode == BenchmarkMode)
+		{
+			Benchmark::Run(Instances, RunTime);
+			Benchmark::Scaling(RunTime);
+		}
+		else if (Mode == VerifyMode)
+			Verify();
 	}
 
 
@@ -2,34 +2,226 @@
 #include "Instance.cpp"
 #include "Global.cpp"
 #include "Permutation.cpp"
+#include "Kernels.cpp"
+
+// Move selection criteria that Solution::UpdateSwapCostMatrix can fold into its pass over the swap cost matrix, so
+// choosing the next move needs no second sweep.  choose(i, j, cost) is called once per pair i < j with the pair's
+// new cost, in the same row-major order as the usual "for i, for j > i" scan, so ties resolve exactly as before.
+
+// Selects nothing; used for plain updates.
+struct NoSwapCriterion
+{
+	inline void operator()(int, int, Cost) {}
+};
+
+// Lowest swap cost, first one found on ties.
+struct MinSwapCriterion
+{
+	int I, J;
+	Cost Min;
+	MinSwapCriterion() { Reset(); }
+	inline void Reset() { I = J = Global::Max; Min = Global::Max; }
+	inline void operator()(int i, int j, Cost delta)
+	{
+		if (delta < Min)
+		{
+			I = i; J = j; Min = delta;
+		}
+	}
+
+	// Row u screened in blocks by their lowest cost, so the running minimum is only carried from block to block and
+	// the few blocks holding a new minimum are walked pair by pair.
+	inline void Row(int u, const Cost *row, int n)
+	{
+		const int Block = 8;
+		int v = u+1;
+		for (; v+Block<=n; v+=Block)
+		{
+			Cost low = row[v];
+			for (int k=v+1; k<v+Block; ++k)
+				low = row[k] < low ? row[k] : low;
+			if (low < Min)
+				for (int k=v; k<v+Block; ++k)
+					(*this)(u, k, row[k]);
+		}
+		for (; v<n; ++v)
+			(*this)(u, v, row[v]);
+	}
+};
+
+// Taillard's robust tabu search choice: the best aspired move if any move is aspired, else the best authorized
+// (non-tabu) one.  Engines derive from it and decide authorized/aspired per pair from their own tabu memory.
+struct TabuSwapCriterion
+{
+	int I, J;
+	Cost Min;
+	bool Aspired;
+	TabuSwapCriterion() { Reset(); }
+	inline void Reset() { I = J = Global::Max; Min = Global::Max; Aspired = false; }
+	inline void Consider(int i, int j, Cost delta, bool authorized, bool aspired)
+	{
+		if ((aspired && !Aspired) || (aspired && Aspired && delta < Min) || 
+			(!aspired && !Aspired && delta < Min && authorized))
+		{
+			I = i; J = j; Min = delta;
+			if (aspired) 
+				Aspired = true;
+		}
+	}
+};
+
+// Hands row u of a swap cost matrix (entries u+1..n-1) to choose.  Criteria with a row kernel overload this
+// (see MinSwapCriterion, TabuMoveCriterion); it is found at instantiation, so the overload may be declared after Solution.
+template<typename Criterion>
+inline void ChooseRow(Criterion& choose, int u, const Cost *row, int n)
+{
+	for (int v=u+1; v<n; ++v)
+		choose(u, v, row[v]);
+}
+
+inline void ChooseRow(MinSwapCriterion& choose, int u, const Cost *row, int n) { choose.Row(u, row, n); }
+
+// Table of one swap cost kernel for every value of Solution::Kernel: the gather code, then for each instance shape
+// (symmetric, zero diagonal) the dense cached kernel compiled for each row width, then the two sparse modes.
+#define QAP_WIDTH_KERNELS(kernel, symmetric, zeroDiagonal) \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse,0>, &Solution::kernel<symmetric,zeroDiagonal,NoSparse,8>, \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse,16>, &Solution::kernel<symmetric,zeroDiagonal,NoSparse,24>, \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse,32>, &Solution::kernel<symmetric,zeroDiagonal,NoSparse,40>, \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse,48>, &Solution::kernel<symmetric,zeroDiagonal,NoSparse,56>, \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse,64>, \
+	&Solution::kernel<symmetric,zeroDiagonal,DistanceSparse,0>, &Solution::kernel<symmetric,zeroDiagonal,FlowSparse,0>
+// Same layout for kernels that do not depend on the row width.
+#define QAP_SHAPE_KERNELS(kernel, symmetric, zeroDiagonal) \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse>, &Solution::kernel<symmetric,zeroDiagonal,NoSparse>, \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse>, &Solution::kernel<symmetric,zeroDiagonal,NoSparse>, \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse>, &Solution::kernel<symmetric,zeroDiagonal,NoSparse>, \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse>, &Solution::kernel<symmetric,zeroDiagonal,NoSparse>, \
+	&Solution::kernel<symmetric,zeroDiagonal,NoSparse>, \
+	&Solution::kernel<symmetric,zeroDiagonal,DistanceSparse>, &Solution::kernel<symmetric,zeroDiagonal,FlowSparse>
+#define QAP_SWAP_KERNELS(gather, variants, kernel) { &Solution::gather, \
+	variants(kernel,false,false), variants(kernel,false,true), variants(kernel,true,false), variants(kernel,true,true) }
 
 
 class Solution : public Permutation
 {
 private: 
-	double *Fitness;
+	Cost Fitness; // valid while HasFitness
+	bool HasFitness;
 	int LastSwap[2];
+	CostMatrix *PermutedFlow; // PermutedFlow[i][j] == Problem.Flow[Values[i]][Values[j]] while cached, NULL otherwise
+	CostMatrix *PermutedFlowT; // its transpose, kept alongside so columns can be streamed as rows; NULL for symmetric instances
+	Cost *UpdateBuffer; // 4 x n scratch vectors for UpdateCachedSwapCostMatrix
+	int *Where; // inverse assignment, Where[Values[i]] == i, kept with the cache when Problem.Sparse == FlowSparse
+	int Kernel; // index into the QAP_SWAP_KERNELS tables, chosen for the instance when the cache is built: 0 gathers through Values
+
+	typedef Cost (Solution::*CostKernel)(int, int);
+	typedef void (Solution::*MatrixKernel)(DeltaMatrix&);
+	typedef void (Solution::*RowKernel)(int, Cost*);
 public:
-	double *LastSwapCost;
+	Cost LastSwapCost; // cost of the last Swap, valid while HasLastSwapCost
+	bool HasLastSwapCost;
 	const Instance& Problem;
-	Solution(const Instance& instance) : Permutation(instance.Size), Problem(instance), LastSwapCost(NULL), Fitness(NULL)
+	Solution(const Instance& instance) : Permutation(instance.Size), Fitness(0), HasFitness(false), PermutedFlow(NULL), PermutedFlowT(NULL), UpdateBuffer(NULL), Where(NULL), Kernel(0), LastSwapCost(0), HasLastSwapCost(false), Problem(instance)
 	{
 		LastSwap[0] = -1; LastSwap[1] = -1;
 	}
 
-	Solution(const Solution& solution) : Permutation(solution.Problem.Size), Problem(solution.Problem), LastSwapCost(NULL), Fitness(NULL)
+	Solution(const Solution& solution) : Permutation(solution.Problem.Size), Fitness(0), HasFitness(false), PermutedFlow(NULL), PermutedFlowT(NULL), UpdateBuffer(NULL), Where(NULL), Kernel(0), LastSwapCost(0), HasLastSwapCost(false), Problem(solution.Problem)
 	{
 		operator=(solution);
 	}
 
+	// Takes over the assignment and the caches of solution, which is left empty (only fit for destruction or
+	// assignment).  Unlike the copy constructor it neither allocates nor draws random numbers.
+	Solution(Solution&& solution) : Permutation(std::move(solution)), Fitness(solution.Fitness), HasFitness(solution.HasFitness), PermutedFlow(solution.PermutedFlow), 
+		PermutedFlowT(solution.PermutedFlowT), UpdateBuffer(solution.UpdateBuffer), Where(solution.Where), Kernel(solution.Kernel), LastSwapCost(solution.LastSwapCost), HasLastSwapCost(solution.HasLastSwapCost), Problem(solution.Problem)
+	{
+		LastSwap[0] = solution.LastSwap[0]; 
+		LastSwap[1] = solution.LastSwap[1];
+		solution.PermutedFlow = solution.PermutedFlowT = NULL;
+		solution.UpdateBuffer = NULL;
+		solution.Where = NULL;
+		solution.Kernel = 0;
+		solution.ClearFitness();
+	}
+
+	// Exchanges buffers with solution when both or neither keep the permuted flow cache, so the cached state of
+	// each side is unchanged by the assignment; otherwise it copies.
+	Solution& operator=(Solution&& solution)
+	{
+		assert(&solution.Problem == &Problem);
+		if ((PermutedFlow == NULL) != (solution.PermutedFlow == NULL))
+			return operator=((const Solution&)solution);
+		Permutation::operator=(std::move(solution));
+		std::swap(PermutedFlow, solution.PermutedFlow);
+		std::swap(PermutedFlowT, solution.PermutedFlowT);
+		std::swap(UpdateBuffer, solution.UpdateBuffer);
+		std::swap(Where, solution.Where);
+		std::swap(Kernel, solution.Kernel);
+		Fitness = solution.Fitness;
+		HasFitness = solution.HasFitness;
+		LastSwapCost = solution.LastSwapCost;
+		HasLastSwapCost = solution.HasLastSwapCost;
+		LastSwap[0] = solution.LastSwap[0]; 
+		LastSwap[1] = solution.LastSwap[1];
+		solution.ClearFitness();
+		return *this;
+	}
+
+	// Keep a copy of the flow matrix permuted by the current assignment so the cost kernels stream two dense matrices
+	// instead of gathering through Values.  Costs an O(n) row/column swap per Swap; worth it for solutions that are
+	// swapped and evaluated many times (the working solution of a search), not for copies like Best.
+	// Only Swap and operator= keep the cache in sync -- do not write through operator[] while it is enabled.
+	inline void CachePermutedFlow(bool enable=true)
+	{
+		if (!enable)
+		{
+			delete PermutedFlow;
+			delete PermutedFlowT;
+			delete [] UpdateBuffer;
+			delete [] Where;
+			PermutedFlow = PermutedFlowT = NULL;
+			UpdateBuffer = NULL;
+			Where = NULL;
+			Kernel = 0;
+			return;
+		}
+		if (PermutedFlow == NULL)
+		{
+			PermutedFlow = new CostMatrix(Problem.Size);
+			if (!Problem.Symmetric)
+				PermutedFlowT = new CostMatrix(Problem.Size);
+			UpdateBuffer = new Cost[4*Problem.Size];
+			if (Problem.Sparse == FlowSparse)
+				Where = new int[Problem.Size];
+			Kernel = 1 + (2*Problem.Symmetric + Problem.ZeroDiagonal)*11 + 
+				(Problem.Sparse == NoSparse ? Problem.Width/8 : 8 + Problem.Sparse);
+		}
+		RefreshPermutedFlow();
+	}
+	inline bool IsPermutedFlowCached() { return PermutedFlow != NULL; }
+
 	Solution& operator=(const Solution &solution)
 	{
 		assert(&solution.Problem == &Problem);
 		for (int i=0; i<Problem.Size; ++i)
 			Values[i] = solution.Values[i];
 		ClearFitness();
-		Fitness = solution.Fitness != NULL ? new double(*solution.Fitness) : NULL;
-		LastSwapCost = solution.LastSwapCost != NULL ? new double(*solution.LastSwapCost) : NULL;
+		if (PermutedFlow != NULL)
+		{
+			if (solution.PermutedFlow != NULL)
+			{
+				Global::CopyMatrix(*PermutedFlow, *solution.PermutedFlow);
+				if (PermutedFlowT != NULL)
+					Global::CopyMatrix(*PermutedFlowT, *solution.PermutedFlowT);
+				RefreshWhere();
+			}
+			else RefreshPermutedFlow();
+		}
+		Fitness = solution.Fitness;
+		HasFitness = solution.HasFitness;
+		LastSwapCost = solution.LastSwapCost;
+		HasLastSwapCost = solution.HasLastSwapCost;
 		LastSwap[0] = solution.LastSwap[0]; 
 		LastSwap[1] = solution.LastSwap[1];		
 		return *this;
@@ -40,30 +232,63 @@ public:
 		return (GetFitness() - Problem.OptimalFitness)/Problem.OptimalFitness * 100;
 	}
 
-	inline double GetFitness()
+	inline Cost GetFitness()
 	{
-		if (Fitness != NULL)
-			return *Fitness;
-		double sum = 0;
+		if (HasFitness)
+			return Fitness;
+		const CostMatrix &a = Problem.Distance;
+		Cost sum = 0;
+		if (PermutedFlow != NULL && Problem.Sparse != NoSparse)
+		{
+			sum = SparseFitness();
+			SetFitness(sum);
+			return sum;
+		}
+		if (PermutedFlow != NULL)
+		{
+			const CostMatrix &f = *PermutedFlow;
+			for (int i=0; i<Problem.Size; ++i)
+			{
+				const Cost *ai = a[i], *fi = f[i];
+				for (int j=0; j<Problem.Size; ++j)
+					sum += ai[j] * fi[j];
+			}
+			SetFitness(sum);
+			return sum;
+		}
+		sum = FreshFitness();
+		SetFitness(sum);
+		return sum;
+	}
+
+	// Fitness summed again from the instance matrices, ignoring the kept value and the permuted flow; for self-checks.
+	inline Cost FreshFitness()
+	{
+		const CostMatrix &a = Problem.Distance, &b = Problem.Flow;
+		Cost sum = 0;
 		for (int i=0; i<Problem.Size; ++i)
+		{
+			const Cost *ai = a[i], *bi = b[Values[i]];
 			for (int j=0; j<Problem.Size; ++j)
-				sum += Problem.Distance[i][j] * Problem.Flow[Values[i]][Values[j]];
-		Fitness = new double(sum);
+				sum += ai[j] * bi[Values[j]];
+		}
 		return sum;
 	}
 
-	inline void Swap(int i, int j, double* swapCost)
+	inline void Swap(int i, int j, Cost* swapCost)
 	{
 		if (i==j) return;
 		Permutation::Swap(i,j);
+		if (PermutedFlow != NULL)
+			SwapPermutedFlow(i,j);
 		LastSwap[0] = i; 
 		LastSwap[1] = j;
 		if (swapCost != NULL)
 		{
-			delete LastSwapCost;
-			LastSwapCost = new double(*swapCost);
-			if (Fitness != NULL)
-				*Fitness += *swapCost;
+			LastSwapCost = *swapCost;
+			HasLastSwapCost = true;
+			if (HasFitness)
+				Fitness += *swapCost;
 		}
 		else
 			ClearFitness();
@@ -71,60 +296,436 @@ public:
 	inline int Size() { return Problem.Size; }
 	inline int& operator[](int index) { return Values[index]; }
 
-	inline void SwapCostMatrix(double** matrix)
+	// Swap cost matrices only hold the upper triangle: matrix[i][j], i < j, is the cost of swapping i and j and the
+	// diagonal is zero.
+	inline void SwapCostMatrix(DeltaMatrix& matrix)
+	{
+		static const MatrixKernel kernels[] = QAP_SWAP_KERNELS(GatherSwapCostMatrix, QAP_WIDTH_KERNELS, CachedSwapCostMatrix);
+		(this->*kernels[Kernel])(matrix);
+	}
+
+	inline void GatherSwapCostMatrix(DeltaMatrix& matrix)
 	{
 		for (int i=0; i<Size(); ++i)
-			for (int j=i; j<Size(); ++j) // set j=i to zero out the diagonal.
-				matrix[j][i] = matrix[i][j] = SwapCost(i,j);
+		{
+			Cost *row = matrix[i];
+			row[i] = 0;
+			for (int j=i+1; j<Size(); ++j)
+				row[j] = GatherSwapCost(i,j);
+		}
 	}
 
-	inline void UpdateSwapCostMatrix(double** matrix)
+	inline void UpdateSwapCostMatrix(DeltaMatrix& matrix)
+	{
+		NoSwapCriterion none;
+		UpdateSwapCostMatrix(matrix, none);
+	}
+
+	// Updates the matrix after the last swap and feeds every new cost to choose (see MinSwapCriterion).
+	template<typename Criterion>
+	inline void UpdateSwapCostMatrix(DeltaMatrix& matrix, Criterion& choose)
+	{
+		typedef void (Solution::*UpdateKernel)(DeltaMatrix&, Criterion&);
+		static const UpdateKernel kernels[] = QAP_SWAP_KERNELS(UpdateGatherSwapCostMatrix, QAP_WIDTH_KERNELS, UpdateCachedSwapCostMatrix);
+		(this->*kernels[Kernel])(matrix, choose);
+	}
+
+	template<typename Criterion>
+	inline void UpdateGatherSwapCostMatrix(DeltaMatrix& matrix, Criterion& choose)
 	{
 		for (int i=0; i<Size(); ++i)
+		{
+			Cost *row = matrix[i];
 			for (int j=i+1; j<Size(); ++j)
-				matrix[j][i] = matrix[i][j] = FastSwapCost(matrix[i][j], i, j); 
+				row[j] = FastSwapCost(row[j], i, j); 
+			ChooseRow(choose, i, row, Size());
+		}
+	}
+
+	// Feeds every cost of an already computed matrix to choose, for when there was no update to fold it into.
+	template<typename Criterion>
+	static inline void ScanSwapCostMatrix(DeltaMatrix& matrix, Criterion& choose)
+	{
+		int n = matrix.Size;
+		for (int i=0; i<n-1; ++i)
+			ChooseRow(choose, i, matrix[i], n);
 	}
 
-	inline double FastSwapCost(double lastSwapCostUV, int u, int v)
+	inline Cost FastSwapCost(Cost lastSwapCostUV, int u, int v)
 	{
 		int r = LastSwap[0], s = LastSwap[1];
 		if (r != u && r != v && s != u && s != v)  // Condition: {r,s} intersect {u,v} == NULL
 		{
-			double **a = Problem.Distance, **b = Problem.Flow;
+			const CostMatrix &a = Problem.Distance, &b = Problem.Flow;
 			int pu = Values[u], pv = Values[v], pr = Values[r], ps = Values[s];
-			return lastSwapCostUV + (a[r][u]-a[r][v]+a[s][v]-a[s][u]) * (b[ps][pu]-b[ps][pv]+b[pr][pv]-b[pr][pu]) 
-								 + (a[u][r]-a[v][r]+a[v][s]-a[u][s]) * (b[pu][ps]-b[pv][ps]+b[pv][pr]-b[pu][pr]);
+			const Cost *ar = a[r], *as = a[s], *au = a[u], *av = a[v];
+			const Cost *bpr = b[pr], *bps = b[ps], *bpu = b[pu], *bpv = b[pv];
+			return lastSwapCostUV + (ar[u]-ar[v]+as[v]-as[u]) * (bps[pu]-bps[pv]+bpr[pv]-bpr[pu]) 
+								 + (au[r]-av[r]+av[s]-au[s]) * (bpu[ps]-bpv[ps]+bpv[pr]-bpu[pr]);
 		}
 		return SwapCost(u,v);
 	}
 
-	inline double SwapCost(int r, int s)
+	inline Cost SwapCost(int r, int s)
 	{
-		if (r == s) return 0;
-		double **a = Problem.Distance, **b = Problem.Flow;
+		static const CostKernel kernels[] = QAP_SWAP_KERNELS(GatherSwapCost, QAP_WIDTH_KERNELS, CachedSwapCost);
+		return r == s ? 0 : (this->*kernels[Kernel])(r,s);
+	}
+
+	inline Cost GatherSwapCost(int r, int s)
+	{
+		const CostMatrix &a = Problem.Distance, &b = Problem.Flow;
 		int pr = Values[r], ps = Values[s];
+		const Cost *ar = a[r], *as = a[s], *bpr = b[pr], *bps = b[ps];
 		
-		double sum = a[r][r]*(b[ps][ps]-b[pr][pr]) + a[r][s]*(b[ps][pr]-b[pr][ps]) + 
-			         a[s][r]*(b[pr][ps]-b[ps][pr]) + a[s][s]*(b[pr][pr]-b[ps][ps]); 
+		Cost sum = ar[r]*(bps[ps]-bpr[pr]) + ar[s]*(bps[pr]-bpr[ps]) + 
+			         as[r]*(bpr[ps]-bps[pr]) + as[s]*(bpr[pr]-bps[ps]); 
 		for (int k=0; k<Problem.Size; ++k)
 		{
 			if (k == r || k == s) continue;
 			int pk = Values[k];
-			sum += a[k][r]*(b[pk][ps]-b[pk][pr]) + a[k][s]*(b[pk][pr]-b[pk][ps]) + 
-				   a[r][k]*(b[ps][pk]-b[pr][pk]) + a[s][k]*(b[pr][pk]-b[ps][pk]);
+			const Cost *ak = a[k], *bpk = b[pk];
+			sum += ak[r]*(bpk[ps]-bpk[pr]) + ak[s]*(bpk[pr]-bpk[ps]) + 
+				   ar[k]*(bps[pk]-bpr[pk]) + as[k]*(bpr[pk]-bps[pk]);
 		}
 		return sum;
 	}
 	
+	// row[s] = SwapCost(r, s) for every position s, row[r] = 0.  With the permuted flow cached and dense instance
+	// matrices the n row dot products of CachedSwapCost are turned around: term k of every one of them reads a[s][k]
+	// and f[s][k], which are row k of the transposes, so the k loop runs outside and each step is one vector kernel
+	// call over all s (the same one UpdateCachedSwapCostMatrix uses).  Rows r of both matrices are read once and
+	// everything else is streamed front to back, instead of n separate calls each gathering a pair of rows.
+	inline void SwapCostRow(int r, Cost *row)
+	{
+		static const RowKernel kernels[] = QAP_SWAP_KERNELS(GatherSwapCostRow, QAP_SHAPE_KERNELS, CachedSwapCostRow);
+		(this->*kernels[Kernel])(r,row);
+		row[r] = 0;
+	}
+
+	inline void GatherSwapCostRow(int r, Cost *row)
+	{
+		for (int s=0; s<Size(); ++s)
+			if (s != r)
+				row[s] = GatherSwapCost(r,s);
+	}
+
+	// Same as SwapCost but reading the permuted flow directly.  The k loop is split into a row dot product and a
+	// column dot product over all n positions (vectorized in Kernels, or over the nonzeros only for sparse
+	// instances), then the k == r and k == s terms they wrongly include are taken back out and the exact r/s terms added.
+	// The instance shape and sparse mode are template arguments so each formula is compiled without branches: when
+	// both matrices are symmetric the column product equals the row product and is not evaluated, and a zero diagonal
+	// folds the r/s corrections down to the a[r][s], f[r][s] terms.  So is the padded row width of small instances
+	// (Instance::Width), which lets the dot products run a fixed number of whole vectors, zero padding included; 0
+	// means any n.
+	template<bool Symmetric, bool ZeroDiagonal, SparseMode Sparse, int Width>
+	inline Cost CachedSwapCost(int r, int s)
+	{
+		const CostMatrix &a = Problem.Distance, &f = *PermutedFlow;
+		const Cost *ar = a[r], *as = a[s], *fr = f[r], *fs = f[s];
+		Cost sum = Sparse != NoSparse ? SparseDot<Sparse,false>(r, s) :
+			Width ? Kernels::DotFixed<Width>(ar, as, fs, fr) : Kernels::Dot(ar, as, fs, fr, Problem.Size);
+		if (Symmetric)
+		{
+			if (ZeroDiagonal)
+				return 2*sum + 4*ar[s]*fr[s];
+			sum -= (ar[r]-as[r])*(fs[r]-fr[r]) + (ar[s]-as[s])*(fs[s]-fr[s]);
+			return 2*sum + (ar[r]-as[s])*(fs[s]-fr[r]);
+		}
+		const CostMatrix &at = Problem.DistanceT, &ft = *PermutedFlowT;
+		sum += Sparse != NoSparse ? SparseDot<Sparse,true>(r, s) :
+			Width ? Kernels::DotFixed<Width>(at[r], at[s], ft[s], ft[r]) : Kernels::Dot(at[r], at[s], ft[s], ft[r], Problem.Size);
+		if (ZeroDiagonal)
+			return sum + 2*(as[r]*fs[r] + ar[s]*fr[s]) + (ar[s]-as[r])*(fs[r]-fr[s]);
+		sum -= (ar[r]-as[r])*(fs[r]-fr[r]) + (ar[r]-ar[s])*(fr[s]-fr[r]) + 
+			   (ar[s]-as[s])*(fs[s]-fr[s]) + (as[r]-as[s])*(fs[s]-fs[r]);
+		sum += ar[r]*(fs[s]-fr[r]) + ar[s]*(fs[r]-fr[s]) + 
+			   as[r]*(fr[s]-fs[r]) + as[s]*(fr[r]-fs[s]); 
+		return sum;
+	}
+
+	// The row dot product of CachedSwapCost, sum over k of (a[r][k]-a[s][k])*(f[s][k]-f[r][k]), or with columns
+	// its column counterpart on the transposes, visiting only the nonzeros of the sparse matrix.  A sparse Distance
+	// is indexed by position like the permuted flow; a sparse Flow is indexed by facility and mapped back through Where.
+	template<SparseMode Sparse, bool Columns>
+	inline Cost SparseDot(int r, int s)
+	{
+		const SparseMatrix<Cost> &m = Columns ? Problem.SparseColumns : Problem.SparseRows;
+		const int *index = m.Index;
+		const Cost *value = m.Value;
+		Cost sum = 0, other = 0; // two independent chains, the loops are latency bound
+		if (Sparse == DistanceSparse)
+		{
+			const CostMatrix &f = Columns ? *PermutedFlowT : *PermutedFlow;
+			const Cost *fr = f[r], *fs = f[s];
+			for (int k=m.Start[r], end=m.Start[r+1]; k<end; ++k)
+				sum += value[k] * (fs[index[k]] - fr[index[k]]);
+			for (int k=m.Start[s], end=m.Start[s+1]; k<end; ++k)
+				other += value[k] * (fs[index[k]] - fr[index[k]]);
+			return sum - other;
+		}
+		const CostMatrix &a = Columns ? Problem.DistanceT : Problem.Distance;
+		const Cost *ar = a[r], *as = a[s];
+		int pr = Values[r], ps = Values[s];
+		for (int k=m.Start[ps], end=m.Start[ps+1]; k<end; ++k)
+		{
+			int w = Where[index[k]];
+			sum += (ar[w] - as[w]) * value[k];
+		}
+		for (int k=m.Start[pr], end=m.Start[pr+1]; k<end; ++k)
+		{
+			int w = Where[index[k]];
+			other += (ar[w] - as[w]) * value[k];
+		}
+		return sum - other;
+	}
+
+	inline Cost SparseFitness()
+	{
+		const SparseMatrix<Cost> &m = Problem.SparseRows;
+		Cost sum = 0;
+		if (Problem.Sparse == DistanceSparse)
+		{
+			const CostMatrix &f = *PermutedFlow;
+			for (int i=0; i<Problem.Size; ++i)
+			{
+				const Cost *fi = f[i];
+				for (int k=m.Start[i]; k<m.Start[i+1]; ++k)
+					sum += m.Value[k] * fi[m.Index[k]];
+			}
+			return sum;
+		}
+		const CostMatrix &a = Problem.Distance;
+		for (int l=0; l<Problem.Size; ++l)
+		{
+			const Cost *ai = a[Where[l]];
+			for (int k=m.Start[l]; k<m.Start[l+1]; ++k)
+				sum += ai[Where[m.Index[k]]] * m.Value[k];
+		}
+		return sum;
+	}
+
+	// The k loop of CachedSwapCost for all s at once.  UpdateRow adds (xu-x[s])*(yu-y[s]) + (pu-p[s])*(qu-q[s]) to
+	// row[s], with xu-x[s] = a[r][k]-a[s][k] and yu-y[s] = f[r][k]-f[s][k]: the negated term of the row dot product,
+	// and of the column one through the p, q pair (the symmetric kernel doubles the single product instead).  Rows k
+	// go through the kernel four at a time; the negated sums are then finished with the r/s corrections of CachedSwapCost.
+	template<bool Symmetric, bool ZeroDiagonal, SparseMode Sparse>
+	inline void CachedSwapCostRow(int r, Cost *row)
+	{
+		int n = Size();
+		if (Sparse != NoSparse) // the nonzeros of a sparse matrix are gathered, so the dot products stay one by one
+		{
+			for (int s=0; s<n; ++s)
+				if (s != r)
+					row[s] = CachedSwapCost<Symmetric,ZeroDiagonal,Sparse,0>(r,s);
+			return;
+		}
+		const CostMatrix &a = Problem.Distance, &f = *PermutedFlow;
+		const CostMatrix &at = Symmetric ? a : Problem.DistanceT, &ft = Symmetric ? f : *PermutedFlowT;
+		const Cost *ar = a[r], *fr = f[r], *atr = at[r], *ftr = ft[r];
+		for (int s=0; s<n; ++s)
+			row[s] = 0;
+		int k = 0;
+		for (; k+Kernels::RowBlock<=n; k+=Kernels::RowBlock)
+			Kernels::UpdateRowBlock<Symmetric>(row, at[k], ft[k], a[k], f[k], a.Stride, ar+k, fr+k, atr+k, ftr+k, n);
+		for (; k<n; ++k)
+			Kernels::UpdateRow<Symmetric>(row, at[k], ft[k], a[k], f[k], ar[k], fr[k], atr[k], ftr[k], 0, n);
+		for (int s=0; s<n; ++s)
+		{
+			const Cost *as = a[s], *fs = f[s];
+			Cost sum = -row[s];
+			if (Symmetric)
+			{
+				if (ZeroDiagonal)
+					row[s] = sum + 4*ar[s]*fr[s];
+				else
+					row[s] = sum - 2*((ar[r]-as[r])*(fs[r]-fr[r]) + (ar[s]-as[s])*(fs[s]-fr[s])) + (ar[r]-as[s])*(fs[s]-fr[r]);
+			}
+			else if (ZeroDiagonal)
+				row[s] = sum + 2*(as[r]*fs[r] + ar[s]*fr[s]) + (ar[s]-as[r])*(fs[r]-fr[s]);
+			else
+			{
+				sum -= (ar[r]-as[r])*(fs[r]-fr[r]) + (ar[r]-ar[s])*(fr[s]-fr[r]) + 
+					   (ar[s]-as[s])*(fs[s]-fr[s]) + (as[r]-as[s])*(fs[s]-fs[r]);
+				row[s] = sum + ar[r]*(fs[s]-fr[r]) + ar[s]*(fs[r]-fr[s]) + 
+					   as[r]*(fr[s]-fs[r]) + as[s]*(fr[r]-fs[s]);
+			}
+		}
+	}
+
+	template<bool Symmetric, bool ZeroDiagonal, SparseMode Sparse, int Width>
+	inline void CachedSwapCostMatrix(DeltaMatrix& matrix)
+	{
+		for (int i=0; i<Size(); ++i)
+		{
+			Cost *row = matrix[i];
+			row[i] = 0;
+			for (int j=i+1; j<Size(); ++j)
+				row[j] = CachedSwapCost<Symmetric,ZeroDiagonal,Sparse,Width>(i,j);
+		}
+	}
+
+	// Taillard's O(1) update over the whole matrix.  With x = ar-as, y = fs-fr and p, q the same differences taken
+	// down the columns, entry (u,v) changes by (x[u]-x[v])*(y[u]-y[v]) + (p[u]-p[v])*(q[u]-q[v]), so each row is one
+	// vector kernel call.  For symmetric instances p == x and q == y.  The 2n pairs touching r or s are recomputed
+	// in full: rows r and s outright, columns r and s right after the kernel has run over the rest of each row, so a
+	// row is final -- and handed to choose -- while it is still in cache.
+	template<bool Symmetric, bool ZeroDiagonal, SparseMode Sparse, int Width, typename Criterion>
+	inline void UpdateCachedSwapCostMatrix(DeltaMatrix& matrix, Criterion& choose)
+	{
+		int r = LastSwap[0], s = LastSwap[1], n = Size();
+		const CostMatrix &a = Problem.Distance, &f = *PermutedFlow;
+		const Cost *ar = a[r], *as = a[s], *fr = f[r], *fs = f[s];
+		Cost *x = UpdateBuffer, *y = x + n, *p = x, *q = y;
+		for (int w=0; w<n; ++w)
+		{
+			x[w] = ar[w] - as[w];
+			y[w] = fs[w] - fr[w];
+		}
+		if (!Symmetric)
+		{
+			const CostMatrix &at = Problem.DistanceT, &ft = *PermutedFlowT;
+			const Cost *atr = at[r], *ats = at[s], *ftr = ft[r], *fts = ft[s];
+			p = y + n; q = p + n;
+			for (int w=0; w<n; ++w)
+			{
+				p[w] = atr[w] - ats[w];
+				q[w] = fts[w] - ftr[w];
+			}
+		}
+		for (int u=0; u<n-1; ++u)
+		{
+			Cost *row = matrix[u];
+			if (u == r || u == s)
+			{
+				for (int v=u+1; v<n; ++v)
+					row[v] = CachedSwapCost<Symmetric,ZeroDiagonal,Sparse,Width>(u,v);
+			}
+			else
+			{
+				Kernels::UpdateRow<Symmetric>(row, x, y, p, q, x[u], y[u], p[u], q[u], u+1, n);
+				if (r > u) row[r] = CachedSwapCost<Symmetric,ZeroDiagonal,Sparse,Width>(u,r);
+				if (s > u) row[s] = CachedSwapCost<Symmetric,ZeroDiagonal,Sparse,Width>(u,s);
+			}
+			ChooseRow(choose, u, row, n);
+		}
+	}
+
+	inline void RefreshPermutedFlow()
+	{
+		const CostMatrix &b = Problem.Flow;
+		CostMatrix &f = *PermutedFlow;
+		for (int i=0; i<Problem.Size; ++i)
+		{
+			const Cost *bi = b[Values[i]];
+			Cost *fi = f[i];
+			for (int j=0; j<Problem.Size; ++j)
+				fi[j] = bi[Values[j]];
+		}
+		if (PermutedFlowT != NULL)
+		{
+			CostMatrix &ft = *PermutedFlowT;
+			for (int i=0; i<Problem.Size; ++i)
+				for (int j=0; j<Problem.Size; ++j)
+					ft[j][i] = f[i][j];
+		}
+		RefreshWhere();
+	}
+
+	inline void RefreshWhere()
+	{
+		if (Where == NULL) return;
+		for (int i=0; i<Problem.Size; ++i)
+			Where[Values[i]] = i;
+	}
+
+	// Exchanging the assignments of i and j exchanges rows i,j and columns i,j of the permuted flow (and its transpose).
+	inline void SwapPermutedFlow(int i, int j)
+	{
+		SwapRowsAndColumns(*PermutedFlow, i, j);
+		if (PermutedFlowT != NULL)
+			SwapRowsAndColumns(*PermutedFlowT, i, j);
+		if (Where != NULL)
+		{
+			Where[Values[i]] = i;
+			Where[Values[j]] = j;
+		}
+	}
+
+	inline void SwapRowsAndColumns(CostMatrix &f, int i, int j)
+	{
+		Cost *fi = f[i], *fj = f[j], t;
+		for (int k=0; k<Problem.Size; ++k)
+		{
+			t = fi[k]; fi[k] = fj[k]; fj[k] = t;
+		}
+		for (int k=0; k<Problem.Size; ++k)
+		{
+			Cost *fk = f[k];
+			t = fk[i]; fk[i] = fk[j]; fk[j] = t;
+		}
+	}
+
+	inline void SetFitness(Cost fitness)
+	{
+		Fitness = fitness;
+		HasFitness = true;
+	}
+
 	inline void ClearFitness()
 	{
-		delete LastSwapCost;
-		LastSwapCost = NULL;
-		delete Fitness;
-		Fitness = NULL;
+		HasLastSwapCost = HasFitness = false;
 	}
 	~Solution()
 	{
-		ClearFitness();
+		delete PermutedFlow;
+		delete PermutedFlowT;
+		delete [] UpdateBuffer;
+		delete [] Where;
+	}
+
+	// Cross-checks the cached, vectorized swap cost paths against the plain gather code at every kernel level the
+	// CPU supports, over a fixed sequence of swaps.  Results must match exactly (cost data is integral).
+	static bool VerifyKernels(const Instance& instance)
+	{
+		int n = instance.Size;
+		if (n < 2) return true;
+		RandomGenerator random = Global::GetRandomState();
+		KernelLevel saved = Kernels::Level(), detected = Kernels::Detect();
+		bool same = true;
+		for (int level=ScalarKernels; level<=detected && same; ++level)
+		{
+			Kernels::Level() = (KernelLevel)level;
+			Solution reference(instance), cached(instance);
+			cached = reference;
+			cached.CachePermutedFlow();
+			DeltaMatrix expected(n), actual(n);
+			Cost *row = new Cost[n];
+			reference.SwapCostMatrix(expected);
+			cached.SwapCostMatrix(actual);
+			for (int k=0; k<min(n,50) && same; ++k)
+			{
+				for (int i=0; i<n && same; ++i)
+					for (int j=i; j<n && same; ++j)
+						same = expected[i][j] == actual[i][j];
+				cached.SwapCostRow(k % n, row);
+				for (int j=0; j<n && same; ++j)
+					same = row[j] == (j < k % n ? expected[j][k % n] : expected[k % n][j]);
+				int i = (7*k+1) % n, j = (13*k+5) % n;
+				if (i == j) j = (j+1) % n;
+				if (i > j) std::swap(i, j);
+				Cost delta = expected[i][j];
+				reference.Swap(i, j, &delta);
+				cached.Swap(i, j, &delta);
+				reference.UpdateSwapCostMatrix(expected);
+				cached.UpdateSwapCostMatrix(actual);
+			}
+			delete [] row;
+			if (!same)
+				cerr << "Swap cost kernels at level " << level << " disagree with the reference code on " << instance.InstanceName << endl;
+		}
+		Kernels::Level() = saved;
+		Global::SetRandomState(random);
+		return same;
 	}
 };
@@ -0,0 +1,194 @@
+#pragma once
+#include "Matrix.cpp"
+#include "Solution.cpp"
+
+// Tabu state shared by the tabu search engines: Until(i, l) is the iteration until which moving i back to location l
+// stays forbidden.  Held as int, with a transposed copy so a row scan reads Until(v, l) for fixed l contiguously.
+// An engine can also have it track its working solution p: Pairs[u][v] then holds min(Until(u, p[v]), Until(v, p[u])),
+// the only value the robust tabu tests need for the swap of u and v, packed in the same triangle layout as the swap
+// cost matrix so a scan reads both front to back in step instead of gathering from two n x n matrices.
+class TabuMemory
+{
+private:
+	BasicMatrix<int> Expiry, ExpiryT;
+	TriangularMatrix<int> Pairs;
+	Solution *Tracked;
+	TabuMemory(const TabuMemory&);
+	TabuMemory& operator=(const TabuMemory&);
+
+	inline int PairUntil(int u, int v)
+	{
+		Solution &p = *Tracked;
+		return min(Expiry[u][p[v]], Expiry[v][p[u]]);
+	}
+
+	inline void RefreshPairs(int i)
+	{
+		for (int k=0; k<i; ++k)
+			Pairs[k][i] = PairUntil(k, i);
+		int *row = Pairs[i];
+		for (int k=i+1; k<Pairs.Size; ++k)
+			row[k] = PairUntil(i, k);
+	}
+public:
+	TabuMemory() : Tracked(NULL) {}
+	TabuMemory(int n, bool staggered=true) : Tracked(NULL) { Create(n, staggered); }
+
+	// Staggered initial values -(n*i+l) break ties between never-used moves the way Taillard's code does.
+	inline void Create(int n, bool staggered=true)
+	{
+		Expiry.Create(n);
+		ExpiryT.Create(n);
+		if (staggered)
+			for (int i=0; i<n; ++i)
+				for (int l=0; l<n; ++l)
+					Forbid(i, l, -(n*i + l));
+	}
+
+	inline void Delete()
+	{
+		Expiry.Delete();
+		ExpiryT.Delete();
+		Pairs.Delete();
+		Tracked = NULL;
+	}
+
+	// Starts keeping Pairs for p.  While tracking, the engine calls Moved after each swap and the Forbid calls that
+	// go with it (which may only forbid the locations the two swapped units just left), and Refresh after anything
+	// else that changes p or the tabu state.
+	inline void Track(Solution& p)
+	{
+		Tracked = &p;
+		Pairs.Create(p.Size());
+		Refresh();
+	}
+
+	inline bool IsTracking() const { return Tracked != NULL; }
+
+	inline void Refresh()
+	{
+		for (int u=0; u<Pairs.Size; ++u)
+		{
+			int *row = Pairs[u];
+			for (int v=u+1; v<Pairs.Size; ++v)
+				row[v] = PairUntil(u, v);
+		}
+	}
+
+	// Brings the pairs of i and j up to date after the tracked solution swapped them.
+	inline void Moved(int i, int j)
+	{
+		RefreshPairs(i);
+		RefreshPairs(j);
+	}
+
+	inline int Until(int i, int location) const { return Expiry[i][location]; }
+	inline void Forbid(int i, int location, int until)
+	{
+		Expiry[i][location] = until;
+		ExpiryT[location][i] = until;
+	}
+	inline const int* Row(int i) const { return Expiry[i]; }
+	inline const int* Column(int location) const { return ExpiryT[location]; }
+	inline const int* PairRow(int u) const { return Pairs[u]; }
+};
+
+// Robust tabu search move choice for iteration Run: swapping i and j is authorized unless both i and j would move
+// back to locations forbidden past Run, and aspired if one of them has been forbidden no later than Run-Aspiration or
+// the move beats the best fitness.  Row evaluates a whole row of the swap cost matrix with the tests folded into
+// masks, so the only branch left per pair is the rarely taken "new choice" one.
+struct TabuMoveCriterion : TabuSwapCriterion
+{
+	const TabuMemory &Tabu;
+	Solution *Current;
+	Cost Fitness, BestFitness;
+	int Run, Aspiration;
+
+	TabuMoveCriterion(const TabuMemory& tabu, int aspiration=0) : Tabu(tabu), Current(NULL), Fitness(0), BestFitness(0), Run(-1), Aspiration(aspiration) {}
+
+	inline void Reset(int run, Solution& current, Cost bestFitness)
+	{
+		TabuSwapCriterion::Reset();
+		Run = run;
+		Current = &current;
+		Fitness = current.GetFitness();
+		BestFitness = bestFitness;
+	}
+
+	inline void operator()(int i, int j, Cost delta)
+	{
+		Solution &p = *Current;
+		int a = Tabu.Until(i, p[j]), b = Tabu.Until(j, p[i]);
+		Consider(i, j, delta, a < Run || b < Run, a < Run - Aspiration || b < Run - Aspiration || Fitness + delta < BestFitness);
+	}
+
+	inline void Row(int u, const Cost *row, int n)
+	{
+		if (Tabu.IsTracking())
+		{
+			PairRow(u, row, n);
+			return;
+		}
+		Solution &p = *Current;
+		const int *tu = Tabu.Row(u), *tpu = Tabu.Column(p[u]);
+		int aged = Run - Aspiration;
+		for (int v=u+1; v<n; ++v)
+		{
+			int a = tu[p[v]], b = tpu[v];
+			Cost delta = row[v];
+			bool less = delta < Min;
+			bool authorized = (a < Run) | (b < Run);
+			bool aspired = (a < aged) | (b < aged) | (Fitness + delta < BestFitness);
+			if ((aspired & (!Aspired | less)) | (!aspired & !Aspired & authorized & less))
+			{
+				I = u; J = v; Min = delta;
+				Aspired |= aspired;
+			}
+		}
+	}
+
+	// Row with the tabu memory tracking Current: a < x || b < x is min(a, b) < x, which Pairs already holds.  The
+	// row is screened in blocks by its lowest cost and lowest tabu value, with no dependency from one pair to the
+	// next.  No pair of a block can be taken unless the lowest cost beats Min, or, before anything is aspired, the
+	// lowest cost beats the best fitness or the lowest tabu value is aged -- so most blocks are skipped, and since
+	// Min only falls and Aspired only gets set, the few that pass are walked pair by pair with the usual test.
+	inline void PairRow(int u, const Cost *row, int n)
+	{
+		const int Block = 8;
+		const int *tabu = Tabu.PairRow(u);
+		int aged = Run - Aspiration;
+		int v = u+1;
+		for (; v+Block<=n; v+=Block)
+		{
+			Cost low = row[v];
+			int until = tabu[v];
+			for (int k=v+1; k<v+Block; ++k)
+			{
+				low = row[k] < low ? row[k] : low;
+				until = tabu[k] < until ? tabu[k] : until;
+			}
+			if (low < Min || (!Aspired && (until < aged || Fitness + low < BestFitness)))
+				PairRange(u, row, tabu, aged, v, v+Block);
+		}
+		PairRange(u, row, tabu, aged, v, n);
+	}
+
+	inline void PairRange(int u, const Cost *row, const int *tabu, int aged, int from, int to)
+	{
+		for (int v=from; v<to; ++v)
+		{
+			int until = tabu[v];
+			Cost delta = row[v];
+			bool less = delta < Min;
+			bool authorized = until < Run;
+			bool aspired = (until < aged) | (Fitness + delta < BestFitness);
+			if ((aspired & (!Aspired | less)) | (!aspired & !Aspired & authorized & less))
+			{
+				I = u; J = v; Min = delta;
+				Aspired |= aspired;
+			}
+		}
+	}
+};
+
+inline void ChooseRow(TabuMoveCriterion& choose, int u, const Cost *row, int n) { choose.Row(u, row, n); }